@@ -1,15 +1,36 @@
 #pragma once
 
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#ifdef ANY_ITERATOR_COUNTERS
+#include <array>
+#include <atomic>
+#endif
+
 template <typename T, typename Tag>
 struct any_iterator;
 
 namespace detail {
 using diff_type = std::ptrdiff_t;
 
-static int const SIZE = sizeof(void*);
+// room for the vtable pointer and four pointers: enough for vector, list,
+// map and deque iterators (a deque one is four pointers) and simple
+// adaptors over them, so erased random access over a deque copies and
+// steps its iterator without allocating
+static int const SIZE = 5 * sizeof(void*);
 static int const ALIGN = alignof(void*);
 
-using aligned_storage = std::aligned_storage<SIZE, ALIGN>;
+using aligned_storage = std::aligned_storage_t<SIZE, ALIGN>;
+using memory_resource = std::pmr::memory_resource;
 
 template <typename T>
 constexpr bool fits_small_buf =
@@ -17,6 +38,53 @@ constexpr bool fits_small_buf =
     && ALIGN % alignof(T) == 0
     && std::is_nothrow_move_constructible_v<T>;
 
+// small models of trivially copyable iterators are moved, copied and
+// destroyed by copying the raw buffer, without touching the vtable
+template <typename It>
+constexpr bool trivially_relocatable = std::is_trivially_copyable_v<It>;
+
+// contiguous sources are erased as plain pointers: the model is small,
+// trivially relocatable and any_iterator can do arithmetic on it inline.
+// only for elements of type T itself: a Derived* converts to Base*, but
+// stepping it as a Base* would use the wrong stride
+template <typename T, typename It>
+concept contiguous_source = std::contiguous_iterator<It>
+    && std::same_as<std::remove_cv_t<std::iter_value_t<It>>, std::remove_cv_t<T>>
+    && std::is_convertible_v<decltype(std::to_address(std::declval<It const&>())), T*>;
+
+template <typename T, typename It>
+auto erase_source(It it) {
+  if constexpr (contiguous_source<T, It>) {
+    return static_cast<T*>(std::to_address(it));
+  } else {
+    return it;
+  }
+}
+
+// opt-in instrumentation: with ANY_ITERATOR_COUNTERS defined before the
+// first include, every storage event below is counted process-wide (see
+// any_iterator_counters). otherwise count() is empty and compiles away.
+// the macro must be defined the same way in every translation unit of a
+// program: count() is one inline function whose body depends on it, so
+// mixing the two is an ODR violation (any_iterator_bench.cpp defines it)
+enum class counter {
+  small_models,     // models placed in the small buffer
+  heap_models,      // models placed in memory from the resource
+  copies,           // any_iterator copies, by construction or assignment
+  heap_allocations, // allocations from the resource
+  count_
+};
+
+#ifdef ANY_ITERATOR_COUNTERS
+inline std::array<std::atomic<std::size_t>, static_cast<std::size_t>(counter::count_)> counters{};
+#endif
+
+inline void count([[maybe_unused]] counter c) noexcept {
+#ifdef ANY_ITERATOR_COUNTERS
+  counters[static_cast<std::size_t>(c)].fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
 template <typename T>
 concept dec = requires (T it) {
   {--it};
@@ -46,8 +114,9 @@ template <typename T>
 struct base_concept {
   virtual ~base_concept() = default;
 
-  virtual void copy(bool, aligned_storage&) = 0;
-  virtual void move(bool, aligned_storage&) = 0;
+  virtual void copy(bool, aligned_storage&, memory_resource*) = 0;
+  virtual void relocate(aligned_storage&) noexcept = 0;
+  virtual void destroy(bool, memory_resource*) noexcept = 0;
 
   virtual T* operator->() = 0;
   virtual T const* operator->() const = 0;
@@ -59,6 +128,10 @@ struct base_concept {
 
   virtual bool operator==(void*) = 0;
 
+  // copies up to n elements to out, advancing until the iterator equals
+  // the one behind the last argument; returns the number copied
+  virtual diff_type read(T*, diff_type, void*) = 0;
+
   // optional operators
 
   virtual void operator--() = 0;
@@ -69,6 +142,9 @@ struct base_concept {
 
   virtual diff_type operator-(void*) = 0;
 
+  // it[d] without copying the iterator
+  virtual T& at(diff_type) = 0;
+
   virtual bool operator<(void*) = 0;
   virtual bool operator>(void*) = 0;
 };
@@ -78,6 +154,19 @@ void set_dynamic(base_concept<T> const* obj, aligned_storage& buf) noexcept {
   reinterpret_cast<void const*&>(buf) = obj;
 }
 
+// heap models are placed in memory taken from the iterator's resource
+template <typename M, typename... Args>
+M* allocate_model(memory_resource* resource, Args&&... args) {
+  void* mem = resource->allocate(sizeof(M), alignof(M));
+  count(counter::heap_allocations);
+  try {
+    return new (mem) M(std::forward<Args>(args)...);
+  } catch (...) {
+    resource->deallocate(mem, sizeof(M), alignof(M));
+    throw;
+  }
+}
+
 template <typename T, typename It>
 struct model : base_concept<T> {
   using C = base_concept<T>;
@@ -87,35 +176,41 @@ struct model : base_concept<T> {
   explicit model(It it) : iterator(std::move(it)) {}
 
   model(model const& other) : iterator(other.iterator) {}
-  model(model&& other) : iterator(std::move(other.iterator)) {}
+  model(model&& other) noexcept(std::is_nothrow_move_constructible_v<It>)
+      : iterator(std::move(other.iterator)) {}
 
-  void copy(bool small, aligned_storage& buf) override {
+  void copy(bool small, aligned_storage& buf, memory_resource* resource) override {
     if (small) {
       new (&buf) model(*this);
     } else {
-      set_dynamic(static_cast<C*>(new model(*this)), buf);
+      set_dynamic(static_cast<C*>(allocate_model<model>(resource, *this)), buf);
     }
   }
 
-  void move(bool small, aligned_storage& buf) override {
-    if (small) {
-      new (&buf) model(std::move(*this));
-    } else {
-      set_dynamic(static_cast<C*>(new model(std::move(*this))), buf);
+  // only called for small models, heap ones are moved by stealing the pointer
+  void relocate(aligned_storage& buf) noexcept override {
+    new (&buf) model(std::move(*this));
+    this->~model();
+  }
+
+  void destroy(bool small, memory_resource* resource) noexcept override {
+    this->~model();
+    if (!small) {
+      resource->deallocate(this, sizeof(model), alignof(model));
     }
   }
 
   T* operator->() override {
-    return iterator.operator->();
+    return std::addressof(*iterator);
   }
   T const* operator->() const override {
-    return iterator.operator->();
+    return std::addressof(*iterator);
   }
   T& operator*() override {
-    return iterator.operator*();
+    return *iterator;
   }
   T const& operator*() const override {
-    return iterator.operator*();
+    return *iterator;
   }
 
   void operator++() override {
@@ -129,6 +224,19 @@ struct model : base_concept<T> {
     return iterator == static_cast<model*>(other)->iterator;
   }
 
+  diff_type read(T* out, diff_type n, void* last) override {
+    if constexpr (std::is_copy_assignable_v<T>) {
+      It const& end = static_cast<model*>(last)->iterator;
+      diff_type i = 0;
+      for (; i < n && !(iterator == end); ++i, ++iterator) {
+        out[i] = *iterator;
+      }
+      return i;
+    } else {
+      return 0;
+    }
+  }
+
   void operator--() {
     if constexpr (dec<It>)
       --iterator;
@@ -156,6 +264,14 @@ struct model : base_concept<T> {
       return 0;
   }
 
+  T& at(diff_type d) override {
+    if constexpr (add_and_sub<It>) {
+      return iterator[d];
+    } else {
+      return *iterator;
+    }
+  }
+
   bool operator<(void* other) {
     if constexpr (cmp<It>)
       return iterator < static_cast<model*>(other)->iterator;
@@ -170,6 +286,10 @@ struct model : base_concept<T> {
       return false;
   }
 
+  It& base() noexcept {
+    return iterator;
+  }
+
 private:
   It iterator;
 };
@@ -178,46 +298,128 @@ template <typename T>
 struct storage {
   using C = base_concept<T>;
 
-  storage() = default;
+  storage() noexcept {
+    set_dynamic<T>(nullptr, buf);
+  }
 
   ~storage() {
-    get()->~C();
+    if (!trivial && get()) {
+      get()->destroy(small, resource);
+    }
+  }
+
+  // the memory resource travels with the iterator: copies and moves
+  // allocate from the same resource as their source
+  storage(storage const& other)
+      : resource(other.resource), small(other.small),
+        trivial(other.trivial), contiguous(other.contiguous) {
+    count(counter::copies);
+    if (contiguous) {
+      count(counter::small_models);
+      new (&buf) model<T, T*>(other.pointer());
+    } else if (trivial) {
+      count(counter::small_models);
+      buf = other.buf;
+    } else if (other.get()) {
+      count(small ? counter::small_models : counter::heap_models);
+      other.get()->copy(small, buf, resource);
+    } else {
+      set_dynamic<T>(nullptr, buf);
+    }
   }
 
-  storage(storage const& other) : small(other.small) {
-    other.get()->copy(small, buf);
+  storage(storage&& other) noexcept {
+    steal(other);
   }
 
-  storage(storage&& other) : small(other.small) {
-    other.get()->move(small, buf);
+  storage& operator=(storage const& other) {
+    if (this != &other) {
+      if (contiguous && other.contiguous) {
+        count(counter::copies);
+        count(counter::small_models);
+        pointer() = other.pointer();
+        resource = other.resource;
+      } else if (trivial && other.trivial) {
+        count(counter::copies);
+        count(counter::small_models);
+        buf = other.buf;
+        resource = other.resource;
+        contiguous = other.contiguous;
+      } else {
+        storage tmp(other);
+        reset();
+        steal(tmp);
+      }
+    }
+
+    return *this;
   }
 
-  storage& operator=(storage&& other) {
+  storage& operator=(storage&& other) noexcept {
     if (this != &other) {
-      get()->~C();
-      small = other.small;
-      other.get()->move(small, buf);
+      reset();
+      steal(other);
     }
 
     return *this;
   }
 
-  void swap(storage& other) {
-    storage tmp = std::move(*this);
-    *this = std::move(other);
-    other = std::move(tmp);
+  void swap(storage& other) noexcept {
+    if (this == &other) {
+      return;
+    }
+    storage tmp;
+    tmp.steal(*this);
+    steal(other);
+    other.steal(tmp);
   }
 
   template <typename It>
-  explicit storage(It it) : small(fits_small_buf<model<T, It>>) {
+  storage(It it, memory_resource* resource)
+      : resource(resource),
+        small(fits_small_buf<model<T, It>>),
+        trivial(fits_small_buf<model<T, It>> && trivially_relocatable<It>),
+        contiguous(std::is_same_v<It, T*>) {
     using M = model<T, It>;
     if constexpr (fits_small_buf<M>) {
+      count(counter::small_models);
       new (&buf) M(std::move(it));
     } else {
-      set_dynamic(static_cast<C*>(new M(std::move(it))), buf);
+      count(counter::heap_models);
+      set_dynamic(static_cast<C*>(allocate_model<M>(resource, std::move(it))), buf);
     }
   }
 
+  void reset() noexcept {
+    if (!trivial && get()) {
+      get()->destroy(small, resource);
+    }
+    set_dynamic<T>(nullptr, buf);
+    small = false;
+    trivial = false;
+    contiguous = false;
+  }
+
+  // moves the model out of other, leaving it empty; this must be empty.
+  // heap models change owner by pointer, small ones are relocated
+  void steal(storage& other) noexcept {
+    resource = other.resource;
+    small = other.small;
+    trivial = other.trivial;
+    contiguous = other.contiguous;
+    if (contiguous) {
+      new (&buf) model<T, T*>(other.pointer());
+    } else if (small && !trivial) {
+      other.get()->relocate(buf);
+    } else {
+      buf = other.buf;
+    }
+    set_dynamic<T>(nullptr, other.buf);
+    other.small = false;
+    other.trivial = false;
+    other.contiguous = false;
+  }
+
   C* get() const noexcept {
     if (small) {
       return reinterpret_cast<C*>(&buf);
@@ -226,6 +428,11 @@ struct storage {
     }
   }
 
+  // the erased pointer of a contiguous source, reached without dispatch
+  T*& pointer() const noexcept {
+    return static_cast<model<T, T*>*>(reinterpret_cast<C*>(&buf))->base();
+  }
+
 //  C const* get() const noexcept {
 //    if (small) {
 //      return reinterpret_cast<C const*>(&buf);
@@ -234,12 +441,38 @@ struct storage {
 //    }
 //  }
 
-  mutable std::aligned_storage<SIZE, ALIGN> buf;
-  bool small;
+  mutable aligned_storage buf;
+  memory_resource* resource{std::pmr::get_default_resource()};
+  bool small{false};
+  bool trivial{false};
+  bool contiguous{false};
 };
 
 } // namespace detail
 
+#ifdef ANY_ITERATOR_COUNTERS
+// snapshot of the detail::counter totals over all threads
+struct any_iterator_counters {
+  std::size_t small_models{0};
+  std::size_t heap_models{0};
+  std::size_t copies{0};
+  std::size_t heap_allocations{0};
+
+  static any_iterator_counters read() noexcept {
+    auto get = [](detail::counter c) {
+      return detail::counters[static_cast<std::size_t>(c)].load(std::memory_order_relaxed);
+    };
+    return {get(detail::counter::small_models), get(detail::counter::heap_models),
+            get(detail::counter::copies), get(detail::counter::heap_allocations)};
+  }
+
+  static void reset() noexcept {
+    for (auto& c : detail::counters) {
+      c.store(0, std::memory_order_relaxed);
+    }
+  }
+};
+#endif
 
 template <typename T, typename Tag>
 struct any_iterator {
@@ -252,25 +485,25 @@ struct any_iterator {
   any_iterator() = default;
 
   template <typename It>
-  any_iterator(It iterator) : storage(std::move(iterator)) {}
+    requires (!std::same_as<It, any_iterator>)
+  any_iterator(It iterator)
+      : storage(detail::erase_source<T>(std::move(iterator)), std::pmr::get_default_resource()) {}
 
-  any_iterator(any_iterator const& other) : storage(other.storage) {}
-  any_iterator(any_iterator&& other) : storage(std::move(other.storage)) {}
+  // heap-allocated models (and all their copies) live in resource
+  template <typename It>
+    requires (!std::same_as<It, any_iterator>)
+  any_iterator(It iterator, std::pmr::memory_resource* resource)
+      : storage(detail::erase_source<T>(std::move(iterator)), resource) {}
 
-  any_iterator& operator=(any_iterator&& other) {
-    if (this != &other) {
-      auto tmp(std::move(other));
-      swap(tmp);
-    }
+  any_iterator(any_iterator const& other) : storage(other.storage) {}
+  any_iterator(any_iterator&& other) noexcept : storage(std::move(other.storage)) {}
 
+  any_iterator& operator=(any_iterator&& other) noexcept {
+    storage = std::move(other.storage);
     return *this;
   }
   any_iterator& operator=(any_iterator const& other) {
-    if (this != &other) {
-      auto tmp = other;
-      swap(tmp);
-    }
-
+    storage = other.storage;
     return *this;
   }
 
@@ -278,36 +511,84 @@ struct any_iterator {
     storage.swap(other.storage);
   }
 
+  friend void swap(any_iterator& a, any_iterator& b) noexcept {
+    a.swap(b);
+  }
+
   template<typename It>
+    requires (!std::same_as<It, any_iterator>)
   any_iterator& operator=(It it) {
-    any_iterator tmp(it);
+    any_iterator tmp(std::move(it), get_memory_resource());
     swap(tmp);
+    return *this;
+  }
+
+  std::pmr::memory_resource* get_memory_resource() const noexcept {
+    return storage.resource;
   }
 
   T const& operator*() const {
+    if (storage.contiguous) {
+      return *storage.pointer();
+    }
     return storage.get()->operator*();
   }
   T& operator*() {
+    if (storage.contiguous) {
+      return *storage.pointer();
+    }
     return storage.get()->operator*();
   }
 
   T const* operator->() const {
+    if (storage.contiguous) {
+      return storage.pointer();
+    }
     return storage.get()->operator->();
   }
   T* operator->() {
+    if (storage.contiguous) {
+      return storage.pointer();
+    }
     return storage.get()->operator->();
   }
 
+  T& operator[](difference_type d) const
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    if (storage.contiguous) {
+      return storage.pointer()[d];
+    }
+    return storage.get()->at(d);
+  }
+
   any_iterator& operator++() & {
+    if (storage.contiguous) {
+      ++storage.pointer();
+      return *this;
+    }
     storage.get()->operator++();
     return *this;
   }
   any_iterator operator++(int) & {
     auto tmp(*this);
-    storage.get()->operator++(0);
+    ++*this;
     return tmp;
   }
 
+  // copies up to n elements to out and advances past them, stopping at
+  // last; returns how many were copied. one dispatch per call, so a loop
+  // over batches pays for the erasure once per batch, not per element
+  difference_type read(T* out, difference_type n, any_iterator const& last)
+      requires std::is_copy_assignable_v<T> {
+    if (storage.contiguous && last.storage.contiguous) {
+      difference_type k = std::min(n, last.storage.pointer() - storage.pointer());
+      std::copy_n(storage.pointer(), k, out);
+      storage.pointer() += k;
+      return k;
+    }
+    return storage.get()->read(out, n, last.storage.get());
+  }
+
   template<typename TT, typename TTag>
   friend bool operator==(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b);
 
@@ -336,6 +617,10 @@ struct any_iterator {
   friend any_iterator<TT, TTag> operator+(any_iterator<TT, TTag>, typename any_iterator<TT, TTag>::difference_type)
       requires std::is_base_of_v<std::random_access_iterator_tag, TTag>;
 
+  template<typename TT, typename TTag>
+  friend any_iterator<TT, TTag> operator+(typename any_iterator<TT, TTag>::difference_type, any_iterator<TT, TTag>)
+      requires std::is_base_of_v<std::random_access_iterator_tag, TTag>;
+
   template<typename TT, typename TTag>
   friend any_iterator<TT, TTag> operator-(any_iterator<TT, TTag>, typename any_iterator<TT, TTag>::difference_type)
       requires std::is_base_of_v<std::random_access_iterator_tag, TTag>;
@@ -348,6 +633,14 @@ struct any_iterator {
   friend bool operator>(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b)
   requires std::is_base_of_v<std::random_access_iterator_tag, TTag>;
 
+  template<typename TT, typename TTag>
+  friend bool operator<=(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b)
+      requires std::is_base_of_v<std::random_access_iterator_tag, TTag>;
+
+  template<typename TT, typename TTag>
+  friend bool operator>=(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b)
+      requires std::is_base_of_v<std::random_access_iterator_tag, TTag>;
+
   template<typename TT, typename TTag>
   friend typename any_iterator<TT, TTag>::difference_type operator-(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b)
       requires std::is_base_of_v<std::random_access_iterator_tag, TTag>;
@@ -360,6 +653,9 @@ private:
 
 template<typename TT, typename TTag>
 bool operator==(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b) {
+  if (a.storage.contiguous && b.storage.contiguous) {
+    return a.storage.pointer() == b.storage.pointer();
+  }
   return a.storage.get()->operator==(b.storage.get());
 }
 
@@ -372,6 +668,10 @@ template<typename TT, typename TTag>
 any_iterator<TT, TTag>& operator--(any_iterator<TT, TTag>& it)
 requires std::is_base_of_v<std::bidirectional_iterator_tag, TTag>
 {
+  if (it.storage.contiguous) {
+    --it.storage.pointer();
+    return it;
+  }
   it.storage.get()->operator--();
   return it;
 }
@@ -381,7 +681,7 @@ any_iterator<TT, TTag> operator--(any_iterator<TT, TTag>& it, int)
 requires std::is_base_of_v<std::bidirectional_iterator_tag, TTag>
 {
   auto tmp(it);
-  it.storage.get()->operator--(0);
+  --it;
   return tmp;
 }
 
@@ -389,6 +689,10 @@ template<typename TT, typename TTag>
 any_iterator<TT, TTag>& operator+=(any_iterator<TT, TTag>& it, typename any_iterator<TT, TTag>::difference_type d)
 requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
 {
+  if (it.storage.contiguous) {
+    it.storage.pointer() += d;
+    return it;
+  }
   it.storage.get()->operator+=(d);
   return it;
 }
@@ -397,28 +701,47 @@ template<typename TT, typename TTag>
 any_iterator<TT, TTag>& operator-=(any_iterator<TT, TTag>& it, typename any_iterator<TT, TTag>::difference_type d)
 requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
 {
+  if (it.storage.contiguous) {
+    it.storage.pointer() -= d;
+    return it;
+  }
   it.storage.get()->operator-=(d);
   return it;
 }
 
+// it is taken by value and returned by move, so for a small model
+// the whole operation is a buffer copy plus the advance
 template<typename TT, typename TTag>
 any_iterator<TT, TTag> operator+(any_iterator<TT, TTag> it, typename any_iterator<TT, TTag>::difference_type d)
 requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
 {
-  return it += d;
+  it += d;
+  return it;
+}
+
+template<typename TT, typename TTag>
+any_iterator<TT, TTag> operator+(typename any_iterator<TT, TTag>::difference_type d, any_iterator<TT, TTag> it)
+requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
+{
+  it += d;
+  return it;
 }
 
 template<typename TT, typename TTag>
 any_iterator<TT, TTag> operator-(any_iterator<TT, TTag> it, typename any_iterator<TT, TTag>::difference_type d)
 requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
 {
-  return it -= d;
+  it -= d;
+  return it;
 }
 
 template<typename TT, typename TTag>
 bool operator<(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b)
 requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
 {
+  if (a.storage.contiguous && b.storage.contiguous) {
+    return a.storage.pointer() < b.storage.pointer();
+  }
   return a.storage.get()->operator<(b.storage.get());
 }
 
@@ -426,12 +749,158 @@ template<typename TT, typename TTag>
 bool operator>(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b)
 requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
 {
+  if (a.storage.contiguous && b.storage.contiguous) {
+    return a.storage.pointer() > b.storage.pointer();
+  }
   return a.storage.get()->operator>(b.storage.get());
 }
 
+template<typename TT, typename TTag>
+bool operator<=(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b)
+requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
+{
+  return !(a > b);
+}
+
+template<typename TT, typename TTag>
+bool operator>=(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b)
+requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
+{
+  return !(a < b);
+}
+
 template<typename TT, typename TTag>
 typename any_iterator<TT, TTag>::difference_type operator-(any_iterator<TT, TTag> const& a, any_iterator<TT, TTag> const& b)
 requires std::is_base_of_v<std::random_access_iterator_tag, TTag>
 {
+  if (a.storage.contiguous && b.storage.contiguous) {
+    return a.storage.pointer() - b.storage.pointer();
+  }
   return a.storage.get()->operator-(b.storage.get());
 }
+
+// closed-set erasure: the iterator is one of Its..., known at compile time.
+// it is kept inline in a variant and every operation is a switch over the
+// alternatives, so calls can be inlined and nothing is ever allocated
+template <typename T, typename Tag, typename... Its>
+struct any_iterator_of {
+  static_assert(sizeof...(Its) > 0);
+
+  using value_type = T;
+  using pointer = T*;
+  using reference = T&;
+  using difference_type = detail::diff_type;
+  using iterator_category = Tag;
+
+  any_iterator_of() = default;
+
+  template <typename It>
+    requires (std::same_as<It, Its> || ...)
+  any_iterator_of(It it) : iterator(std::in_place_type<It>, std::move(it)) {}
+
+  T& operator*() const {
+    return std::visit([](auto const& it) -> T& { return *it; }, iterator);
+  }
+
+  T* operator->() const {
+    return std::addressof(**this);
+  }
+
+  T& operator[](difference_type d) const
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    return std::visit([d](auto const& it) -> T& { return it[d]; }, iterator);
+  }
+
+  any_iterator_of& operator++() & {
+    std::visit([](auto& it) { ++it; }, iterator);
+    return *this;
+  }
+  any_iterator_of operator++(int) & {
+    auto tmp(*this);
+    ++*this;
+    return tmp;
+  }
+
+  any_iterator_of& operator--() &
+      requires std::is_base_of_v<std::bidirectional_iterator_tag, Tag> {
+    std::visit([](auto& it) { --it; }, iterator);
+    return *this;
+  }
+  any_iterator_of operator--(int) &
+      requires std::is_base_of_v<std::bidirectional_iterator_tag, Tag> {
+    auto tmp(*this);
+    --*this;
+    return tmp;
+  }
+
+  any_iterator_of& operator+=(difference_type d)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    std::visit([d](auto& it) { it += d; }, iterator);
+    return *this;
+  }
+  any_iterator_of& operator-=(difference_type d)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    std::visit([d](auto& it) { it -= d; }, iterator);
+    return *this;
+  }
+
+  friend any_iterator_of operator+(any_iterator_of it, difference_type d)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    it += d;
+    return it;
+  }
+  friend any_iterator_of operator+(difference_type d, any_iterator_of it)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    it += d;
+    return it;
+  }
+  friend any_iterator_of operator-(any_iterator_of it, difference_type d)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    it -= d;
+    return it;
+  }
+
+  // iterators holding different alternatives come from different
+  // ranges, so they are never equal and must not be ordered
+  friend bool operator==(any_iterator_of const& a, any_iterator_of const& b) {
+    return a.iterator.index() == b.iterator.index()
+           && a.visit_same(b, [](auto const& x, auto const& y) { return x == y; });
+  }
+  friend bool operator!=(any_iterator_of const& a, any_iterator_of const& b) {
+    return !(a == b);
+  }
+
+  friend difference_type operator-(any_iterator_of const& a, any_iterator_of const& b)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    return a.visit_same(b, [](auto const& x, auto const& y) -> difference_type { return x - y; });
+  }
+
+  friend bool operator<(any_iterator_of const& a, any_iterator_of const& b)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    return a.visit_same(b, [](auto const& x, auto const& y) { return x < y; });
+  }
+  friend bool operator>(any_iterator_of const& a, any_iterator_of const& b)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    return b < a;
+  }
+  friend bool operator<=(any_iterator_of const& a, any_iterator_of const& b)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    return !(b < a);
+  }
+  friend bool operator>=(any_iterator_of const& a, any_iterator_of const& b)
+      requires std::is_base_of_v<std::random_access_iterator_tag, Tag> {
+    return !(a < b);
+  }
+
+private:
+  std::variant<Its...> iterator;
+
+  // dispatches once on this alternative, other must hold the same one
+  template <typename F>
+  decltype(auto) visit_same(any_iterator_of const& other, F f) const {
+    return std::visit([&](auto const& it) {
+      using It = std::remove_cvref_t<decltype(it)>;
+      return f(it, *std::get_if<It>(&other.iterator));
+    }, iterator);
+  }
+};
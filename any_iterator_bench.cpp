@@ -0,0 +1,172 @@
+// any_iterator against the raw iterators it erases, standalone:
+//   g++ -std=c++20 -O2 any_iterator_bench.cpp -o any_iterator_bench
+// reports ns per element for forward, bidirectional and random-access
+// traversal of vector, deque, list and map, then (through the storage
+// counters) where models live and how many allocations a copy makes
+
+#define ANY_ITERATOR_COUNTERS
+#include "any_iterator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <list>
+#include <map>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t N = 1 << 20;
+constexpr int ROUNDS = 5;
+
+// keeps the sums from being optimized away
+volatile long long sink;
+
+// best of ROUNDS, in ns per element
+template <typename F>
+double ns_per_elt(F run) {
+  double best = 1e300;
+  for (int r = 0; r < ROUNDS; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    sink = run();
+    std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+    best = std::min(best, took.count() / N);
+  }
+  return best;
+}
+
+int value(int x) {
+  return x;
+}
+int value(std::pair<int const, int> const& x) {
+  return x.second;
+}
+
+template <typename It>
+long long forward_sum(It first, It last) {
+  long long s = 0;
+  for (; first != last; ++first) {
+    s += value(*first);
+  }
+  return s;
+}
+
+template <typename It>
+long long backward_sum(It first, It last) {
+  long long s = 0;
+  while (last != first) {
+    --last;
+    s += value(*last);
+  }
+  return s;
+}
+
+template <typename It>
+long long indexed_sum(It first, It last) {
+  long long s = 0;
+  auto n = last - first;
+  for (decltype(n) i = 0; i < n; ++i) {
+    s += value(first[i]);
+  }
+  return s;
+}
+
+void row(char const* container, char const* traversal, double raw, double erased) {
+  std::printf("%-8s %-14s %8.2f %8.2f %7.2fx\n", container, traversal, raw, erased, erased / raw);
+}
+
+// every traversal the container's iterators support, raw and erased
+template <typename Container>
+void traversals(char const* name, Container& c) {
+  using value_type = typename Container::value_type;
+  using category = typename std::iterator_traits<typename Container::iterator>::iterator_category;
+  using fwd = any_iterator<value_type, std::forward_iterator_tag>;
+  using bidi = any_iterator<value_type, std::bidirectional_iterator_tag>;
+  using ra = any_iterator<value_type, std::random_access_iterator_tag>;
+
+  row(name, "forward", ns_per_elt([&] { return forward_sum(c.begin(), c.end()); }),
+      ns_per_elt([&] { return forward_sum(fwd(c.begin()), fwd(c.end())); }));
+  row(name, "bidirectional", ns_per_elt([&] { return backward_sum(c.begin(), c.end()); }),
+      ns_per_elt([&] { return backward_sum(bidi(c.begin()), bidi(c.end())); }));
+  if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category>) {
+    row(name, "random access", ns_per_elt([&] { return indexed_sum(c.begin(), c.end()); }),
+        ns_per_elt([&] { return indexed_sum(ra(c.begin()), ra(c.end())); }));
+  }
+}
+
+// a source iterator too big for the small buffer
+struct fat_iterator {
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = int;
+  using difference_type = std::ptrdiff_t;
+  using pointer = int*;
+  using reference = int&;
+
+  std::list<int>::iterator it;
+  char pad[64]{};
+
+  int& operator*() const {
+    return *it;
+  }
+  fat_iterator& operator++() {
+    ++it;
+    return *this;
+  }
+  fat_iterator operator++(int) {
+    fat_iterator tmp(*this);
+    ++it;
+    return tmp;
+  }
+  friend bool operator==(fat_iterator const& a, fat_iterator const& b) {
+    return a.it == b.it;
+  }
+  friend bool operator!=(fat_iterator const& a, fat_iterator const& b) {
+    return a.it != b.it;
+  }
+};
+
+// where a model lands and what copying it costs
+template <typename It>
+void storage(char const* name, It source) {
+  constexpr int copies = 1000;
+  any_iterator_counters::reset();
+  any_iterator<int, std::forward_iterator_tag> it(source);
+  any_iterator_counters placed = any_iterator_counters::read();
+
+  any_iterator_counters::reset();
+  for (int i = 0; i < copies; ++i) {
+    any_iterator<int, std::forward_iterator_tag> copy(it);
+    sink = *copy;
+  }
+  any_iterator_counters copied = any_iterator_counters::read();
+
+  std::printf("%-14s %-6s %10.2f\n", name, placed.heap_models != 0 ? "heap" : "small",
+              static_cast<double>(copied.heap_allocations) / copies);
+}
+
+} // namespace
+
+int main() {
+  std::vector<int> vec(N);
+  std::iota(vec.begin(), vec.end(), 0);
+  std::deque<int> deq(vec.begin(), vec.end());
+  std::list<int> lst(vec.begin(), vec.end());
+  std::map<int, int> map;
+  for (int x : vec) {
+    map.emplace_hint(map.end(), x, x);
+  }
+
+  std::printf("%zu elements, best of %d, ns/elt\n", N, ROUNDS);
+  std::printf("%-8s %-14s %8s %8s %8s\n", "source", "traversal", "raw", "erased", "ratio");
+  traversals("vector", vec);
+  traversals("deque", deq);
+  traversals("list", lst);
+  traversals("map", map);
+
+  std::printf("\n%-14s %-6s %10s\n", "source", "model", "allocs/copy");
+  storage("vector", vec.begin());
+  storage("deque", deq.begin());
+  storage("list", lst.begin());
+  storage("fat iterator", fat_iterator{lst.begin()});
+}
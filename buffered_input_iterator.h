@@ -0,0 +1,219 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "any_iterator.h"
+
+// input iterator over a block producer: producer(out, capacity) writes up to
+// capacity elements to out and returns how many it wrote, 0 means the end.
+// elements are fetched a block at a time, optionally one block ahead on a
+// background thread, so ++it is an index bump almost always
+
+namespace detail {
+
+template <typename T>
+struct block_source {
+  using producer_t = std::function<std::size_t(T*, std::size_t)>;
+
+  block_source(producer_t producer, std::size_t block_size, bool read_ahead)
+      : producer(std::move(producer)),
+        front(block_size),
+        back(read_ahead ? block_size : 0) {
+    if (read_ahead) {
+      requested = true;
+      worker = std::thread([this] { run(); });
+      // the destructor won't run if this throws, and a joinable worker
+      // would terminate the process
+      try {
+        refill();
+      } catch (...) {
+        shut_down();
+        throw;
+      }
+    } else {
+      front_size = this->producer(front.data(), front.size());
+    }
+  }
+
+  block_source(block_source const&) = delete;
+  block_source& operator=(block_source const&) = delete;
+
+  ~block_source() {
+    shut_down();
+  }
+
+  bool at_end() const noexcept {
+    return pos == front_size;
+  }
+
+  T& current() noexcept {
+    return front[pos];
+  }
+
+  void advance() {
+    if (++pos == front_size) {
+      if (worker.joinable()) {
+        refill();
+      } else if (front_size != 0) {
+        front_size = producer(front.data(), front.size());
+      }
+      pos = 0;
+    }
+  }
+
+private:
+  void shut_down() noexcept {
+    if (worker.joinable()) {
+      {
+        std::lock_guard lock(m);
+        stop = true;
+      }
+      cv.notify_all();
+      worker.join();
+    }
+  }
+
+  // waits for the block the worker is filling and asks for the next one
+  void refill() {
+    std::unique_lock lock(m);
+    cv.wait(lock, [this] { return ready; });
+    ready = false;
+    if (error) {
+      std::rethrow_exception(std::exchange(error, nullptr));
+    }
+    front.swap(back);
+    front_size = back_size;
+    if (front_size != 0) {
+      requested = true;
+      lock.unlock();
+      cv.notify_all();
+    }
+  }
+
+  void run() {
+    std::unique_lock lock(m);
+    for (;;) {
+      cv.wait(lock, [this] { return requested || stop; });
+      if (stop) {
+        return;
+      }
+      requested = false;
+      lock.unlock();
+
+      std::size_t n = 0;
+      std::exception_ptr e;
+      try {
+        n = producer(back.data(), back.size());
+      } catch (...) {
+        e = std::current_exception();
+      }
+
+      lock.lock();
+      back_size = n;
+      error = e;
+      ready = true;
+      cv.notify_all();
+    }
+  }
+
+  producer_t producer;
+
+  std::vector<T> front;
+  std::size_t front_size{0};
+  std::size_t pos{0};
+
+  // shared with the worker, guarded by m
+  std::vector<T> back;
+  std::size_t back_size{0};
+  std::exception_ptr error;
+  bool requested{false};
+  bool ready{false};
+  bool stop{false};
+
+  std::mutex m;
+  std::condition_variable cv;
+  std::thread worker;
+};
+
+} // namespace detail
+
+template <typename T>
+struct buffered_input_iterator {
+  using iterator_category = std::input_iterator_tag;
+  using value_type = T;
+  using difference_type = std::ptrdiff_t;
+  using pointer = T*;
+  using reference = T&;
+  using producer_t = typename detail::block_source<T>::producer_t;
+
+  static constexpr std::size_t default_block_size = 4096;
+
+  // end iterator
+  buffered_input_iterator() = default;
+
+  explicit buffered_input_iterator(producer_t producer,
+                                   std::size_t block_size = default_block_size,
+                                   bool read_ahead = false)
+      : source(std::make_shared<detail::block_source<T>>(std::move(producer), block_size, read_ahead)) {}
+
+  reference operator*() const {
+    return source->current();
+  }
+  pointer operator->() const {
+    return &source->current();
+  }
+
+  buffered_input_iterator& operator++() & {
+    source->advance();
+    return *this;
+  }
+
+  // keeps the element alive after the block it came from is overwritten
+  struct postfix_proxy {
+    T value;
+    T& operator*() {
+      return value;
+    }
+  };
+
+  postfix_proxy operator++(int) & {
+    postfix_proxy tmp{std::move(**this)};
+    ++*this;
+    return tmp;
+  }
+
+  friend bool operator==(buffered_input_iterator const& a, buffered_input_iterator const& b) {
+    return a.at_end() ? b.at_end() : a.source == b.source;
+  }
+
+  friend bool operator!=(buffered_input_iterator const& a, buffered_input_iterator const& b) {
+    return !(a == b);
+  }
+
+private:
+  std::shared_ptr<detail::block_source<T>> source;
+
+  bool at_end() const noexcept {
+    return !source || source->at_end();
+  }
+};
+
+// [first, last) range over a producer erased as any_iterator,
+// e.g. to hide a file or socket reader behind an input iterator interface
+template <typename T>
+std::pair<any_iterator<T, std::input_iterator_tag>, any_iterator<T, std::input_iterator_tag>>
+make_buffered_range(typename buffered_input_iterator<T>::producer_t producer,
+                    std::size_t block_size = buffered_input_iterator<T>::default_block_size,
+                    bool read_ahead = false) {
+  return {buffered_input_iterator<T>(std::move(producer), block_size, read_ahead),
+          buffered_input_iterator<T>()};
+}
@@ -1,6 +1,15 @@
-#include <cassert>  // assert
-#include <iterator> // std::reverse_iterator
-#include <utility>  // std::pair, std::swap
+#include <algorithm>     // std::max, std::sort, std::unique
+#include <array>         // std::array
+#include <cassert>       // assert
+#include <concepts>      // std::convertible_to
+#include <cstddef>       // size_t
+#include <cstdint>       // std::uint64_t
+#include <functional>    // std::hash
+#include <iterator>      // std::reverse_iterator
+#include <memory>        // std::shared_ptr, std::addressof
+#include <unordered_map> // std::unordered_map
+#include <utility>       // std::pair, std::swap
+#include <vector>        // std::vector
 
 template <typename T>
 struct persistent_set {
@@ -9,18 +18,32 @@ public:
   using reverse_iterator = std::reverse_iterator<iterator>;
 
   persistent_set()  = default;
-  persistent_set(persistent_set const& other)  : root(other.root) {}
-  persistent_set(persistent_set&& other)  : root(std::move(other.root)) {}
+  // the finger points into the nodes of one version, so copies start without it
+  persistent_set(persistent_set const& other)  : root(other.root), size_(other.size_), filter(other.filter) {}
+  persistent_set(persistent_set&& other)
+      : root(std::move(other.root)),
+        size_(std::exchange(other.size_, 0)),
+        finger(std::move(other.finger)),
+        filter(std::move(other.filter)) {
+    other.finger.clear();
+  }
 
   persistent_set& operator=(persistent_set const& other)  {
     if (this != &other) {
       root = other.root;
+      size_ = other.size_;
+      finger.clear();
+      filter = other.filter;
     }
     return *this;
   }
   persistent_set& operator=(persistent_set&& other)  {
     if (this != &other) {
       root = std::move(other.root);
+      size_ = std::exchange(other.size_, 0);
+      finger = std::move(other.finger);
+      other.finger.clear();
+      filter = std::move(other.filter);
     }
     return *this;
   }
@@ -33,6 +56,11 @@ public:
 
   void clear()  {
     root.left.reset();
+    size_ = 0;
+    finger.clear();
+    if (filter) {
+      filter = std::make_shared<filter_t>(filter->blocks);
+    }
   }
 
   bool empty() const  {
@@ -53,21 +81,75 @@ public:
     return reverse_iterator(begin());
   }
 
+  // the search starts from the finger (the path to the previous insert),
+  // so keys inserted next to each other cost O(1) comparisons
   std::pair<iterator, bool> insert(T const& key) {
-    if (find(key) != end()) {
+    auto [node, inserted] = insert_from_finger(key);
+    if (!inserted) {
       return {end(), false};
     }
+    return {make_iterator(node), true};
+  }
 
-    node_ptr_t new_node = std::make_shared<val_node_t>(key); // ok to throw
-
-    copy_path(key, new_node, nullptr, nullptr);
-    ++size_;
-    return {make_iterator(new_node.get()), true};
+  // returns the inserted or the already present element. unless the
+  // finger already bounds key, it is moved to hint first, so an append
+  // hinted with end() costs O(1) comparisons even after inserts elsewhere.
+  // a hint that doesn't bound key is only slower: the search retreats
+  // from it as from any finger
+  iterator insert(iterator hint, T const& key) {
+    if (hint.root == &root && !finger_covers(key)) {
+      seat_finger(hint.ptr);
+    }
+    return make_iterator(insert_from_finger(key).first);
   }
 
   iterator erase(iterator it);
 
+  // keys < key and keys >= key. both parts share every subtree the search
+  // path for key doesn't cross, only the nodes on that path are copied
+  // (a filter, if any, is shared: it still answers for the parts)
+  std::pair<persistent_set, persistent_set> split(T const& key) const {
+    auto [less, rest] = split_tree(root.left, key);
+    return {persistent_set(std::move(less), filter), persistent_set(std::move(rest), filter)};
+  }
+
+  // keys in [lo, hi), built the same way
+  persistent_set slice(T const& lo, T const& hi) const {
+    node_ptr_t rest = split_tree(root.left, lo).second;
+    return persistent_set(split_tree(rest, hi).first, filter);
+  }
+
+  // optional membership prefilter (needs std::hash<T>): a blocked Bloom
+  // filter consulted by find, so most misses cost one cache line instead
+  // of a root-to-leaf walk. built from the current elements for about
+  // expected_size of them; inserts add to it, erase leaves its bits set,
+  // so after many erases it is worth rebuilding. copies of a version
+  // share the filter and copy only the chunks they change
+  void enable_filter(size_t expected_size) {
+    static_assert(filterable, "the filter needs std::hash<T>");
+    auto fresh = std::make_shared<filter_t>(filter_t::blocks_for(std::max(expected_size, size_)));
+    for (T const& key : *this) {
+      size_t h = filter_t::hash(key);
+      filter_t::set(fresh->writable_block(h), h);
+    }
+    filter = std::move(fresh);
+  }
+
+  void disable_filter() {
+    filter.reset();
+  }
+
+  bool has_filter() const {
+    return filter != nullptr;
+  }
+
   iterator find(T const& key)  {
+    if constexpr (filterable) {
+      if (filter && !filter->may_contain(filter_t::hash(key))) {
+        return end();
+      }
+    }
+
     node_t* cur = root.left_ptr();
     for (;;) {
       if (cur == nullptr) {
@@ -114,8 +196,35 @@ public:
     return make_iterator(res);
   }
 
+  // memory pinned by a version or a group of versions. a node is
+  // exclusive when every reference to it comes from the group (the sets
+  // themselves or exclusive nodes): dropping the group frees exactly the
+  // exclusive nodes, the shared ones are kept alive by other versions.
+  // bytes count sizeof(val_node_t) per node; the shared_ptr control
+  // block and memory owned by T come on top. not exact while other
+  // threads copy or drop versions
+  struct memory_stats {
+    size_t nodes{0};
+    size_t exclusive_nodes{0};
+    size_t shared_nodes{0};
+    size_t bytes{0};
+    size_t exclusive_bytes{0};
+    size_t shared_bytes{0};
+  };
+
+  memory_stats memory_usage() const {
+    return memory_usage(this, this + 1);
+  }
+
+  // [first, last) -- iterators to persistent_set (e.g. persistent_set*)
+  template <typename It>
+  static memory_stats memory_usage(It first, It last);
+
   void swap(persistent_set& other)  {
     std::swap(root, other.root);
+    std::swap(size_, other.size_);
+    std::swap(finger, other.finger);
+    std::swap(filter, other.filter);
   }
 
   friend void swap(persistent_set& a, persistent_set& b)  {
@@ -125,11 +234,35 @@ public:
 private:
   struct node_t;
   struct val_node_t;
+  struct filter_t;
   using node_ptr_t = std::shared_ptr<val_node_t>;
 
+  static constexpr bool filterable = requires(T const& key) {
+    { std::hash<T>{}(key) } -> std::convertible_to<size_t>;
+  };
+
   mutable node_t root;
   size_t size_{0};
 
+  // finger -- path from the tree root to the last inserted node. every
+  // step stores the (1-based, 0 if none) positions of the nearest
+  // ancestors bounding its subtree from below (lo) and above (hi): all
+  // keys under node lie in (lo, hi). the path belongs to this version
+  // only, anything but insert drops it
+  struct finger_step {
+    node_t* node;
+    size_t lo;
+    size_t hi;
+  };
+  std::vector<finger_step> finger;
+
+  std::shared_ptr<filter_t> filter;
+
+  persistent_set(node_ptr_t tree, std::shared_ptr<filter_t> filter)
+      : size_(node_t::count_of(tree)), filter(std::move(filter)) {
+    root.left = std::move(tree);
+  }
+
   static T& get_value(node_t* node) {
     return static_cast<val_node_t*>(node)->value;
   }
@@ -138,45 +271,216 @@ private:
     return iterator(ptr, &root);
   }
 
-  // copy path to node with value = key
-  // if found replace with replace
-  // else insert replace
-  // link left_end and right_end at the end of copied path
-  void copy_path(T const& key, node_ptr_t replace,
-                 node_ptr_t left_end, node_ptr_t right_end) {
+  // drops finger steps until the subtree of the last one can hold key,
+  // jumping straight to the bounding ancestor that excludes it
+  void retreat(T const& key) {
+    while (!finger.empty()) {
+      finger_step const& step = finger.back();
+      if (step.lo != 0 && !(get_value(finger[step.lo - 1].node) < key)) {
+        finger.resize(step.lo);
+      } else if (step.hi != 0 && !(key < get_value(finger[step.hi - 1].node))) {
+        finger.resize(step.hi);
+      } else {
+        return;
+      }
+    }
+  }
+
+  // key belongs in the subtree the finger ends at
+  bool finger_covers(T const& key) const {
+    if (finger.empty()) {
+      return false;
+    }
+    finger_step const& step = finger.back();
+    return (step.lo == 0 || get_value(finger[step.lo - 1].node) < key) &&
+           (step.hi == 0 || key < get_value(finger[step.hi - 1].node));
+  }
+
+  // moves the finger to a hint without comparing keys: a node already on
+  // the finger truncates it there, the end node rebuilds it down the right
+  // spine. any other hint leaves the finger alone, descending to it would
+  // cost as much as the search from the finger it replaces
+  void seat_finger(node_t* node) {
+    if (node == &root) {
+      finger.clear();
+      for (node_t* cur = root.left_ptr(); cur != nullptr; cur = cur->right_ptr()) {
+        push_step(cur, !finger.empty());
+      }
+      return;
+    }
+    for (size_t i = finger.size(); i-- > 0;) {
+      if (finger[i].node == node) {
+        finger.resize(i + 1);
+        return;
+      }
+    }
+  }
+
+  void push_step(node_t* node, bool side) {
+    if (finger.empty()) {
+      finger.push_back({node, 0, 0});
+      return;
+    }
+    size_t parent = finger.size();
+    if (side) {
+      finger.push_back({node, parent, finger.back().hi});
+    } else {
+      finger.push_back({node, finger.back().lo, parent});
+    }
+  }
+
+  // finds key below the finger; if absent, copies the finger path and
+  // hangs a new node at its end. the finger then ends at the found or
+  // inserted node
+  std::pair<node_t*, bool> insert_from_finger(T const& key) {
+    retreat(key);
+    if (finger.empty() && root.left_ptr() != nullptr) {
+      push_step(root.left_ptr(), false);
+    }
+
+    bool side = false;
+    while (!finger.empty()) {
+      node_t* cur = finger.back().node;
+      node_t* next;
+      if (get_value(cur) < key) {
+        next = cur->right_ptr();
+        side = true;
+      } else if (key < get_value(cur)) {
+        next = cur->left_ptr();
+        side = false;
+      } else {
+        return {cur, false};
+      }
+      if (next == nullptr) {
+        break;
+      }
+      push_step(next, side);
+    }
+
+    node_ptr_t new_node = std::make_shared<val_node_t>(key); // ok to throw
+    // the filter block is made writable before the tree changes, so a
+    // throw can't leave a key the filter would deny
+    std::uint64_t* block = nullptr;
+    size_t h = 0;
+    if constexpr (filterable) {
+      if (filter) {
+        if (filter.use_count() > 1) {
+          filter = std::make_shared<filter_t>(*filter);
+        }
+        h = filter_t::hash(key);
+        block = filter->writable_block(h);
+      }
+    }
+    copy_finger(new_node, side);
+    if constexpr (filterable) {
+      if (block) {
+        filter_t::set(block, h);
+      }
+    }
+    ++size_;
+    return {new_node.get(), true};
+  }
+
+  // path copying along the finger: directions are known from the steps,
+  // so no keys are compared. everything that may throw happens before
+  // this version is touched
+  void copy_finger(node_ptr_t const& leaf, bool side) {
+    std::vector<node_ptr_t> copies;
+    copies.reserve(finger.size());
+    for (finger_step const& step : finger) {
+      copies.push_back(std::make_shared<val_node_t>(*static_cast<val_node_t*>(step.node)));
+      ++copies.back()->count;
+    }
+    finger.reserve(finger.size() + 1);
+
+    node_t* parent = &root;
+    bool parent_side = false;
+    for (size_t i = 0; i < copies.size(); ++i) {
+      node_t::link(parent, copies[i], parent_side);
+      finger[i].node = copies[i].get();
+      parent = copies[i].get();
+      parent_side = i + 1 < copies.size() ? finger[i + 1].lo == i + 1 : side;
+    }
+    node_t::link(parent, leaf, parent_side);
+    push_step(leaf.get(), parent_side);
+  }
+
+  // copy path to node with value = key and put replace in its place
+  // (key must be present). shrink: the subtree under every copied node
+  // loses one element. all copies are made before anything is linked,
+  // so a throw leaves this version as it was
+  void copy_path(T const& key, node_ptr_t const& replace, bool shrink) {
+    std::vector<std::pair<node_ptr_t, bool>> copies; // copy, side of the next node
     node_t* cur = root.left_ptr();
-    node_ptr_t cur_copy;
-    node_t* successor = &root;
-    bool side = 0; // 0 - L, 1 - R
     for (;;) {
-      if (cur == nullptr || get_value(cur) == key) {
-        node_t::link(successor, replace, side);
-        node_t::link_left(replace.get(), left_end);
-        node_t::link_right(replace.get(), right_end);
-        return;
+      bool side;
+      if (get_value(cur) < key) {
+        side = true;
+      } else if (key < get_value(cur)) {
+        side = false;
+      } else {
+        break;
       }
 
-      try {
-        cur_copy = std::make_shared<val_node_t>(*static_cast<val_node_t*>(cur));
-      } catch(...) {
-        // successor is already linked to cur
-        replace.reset();
-        throw;
+      copies.emplace_back(std::make_shared<val_node_t>(*static_cast<val_node_t*>(cur)), side);
+      if (shrink) {
+        --copies.back().first->count;
       }
-      node_t::link(successor, cur_copy, side);
+      cur = side ? cur->right_ptr() : cur->left_ptr();
+    }
+
+    node_t* successor = &root;
+    bool side = 0; // 0 - L, 1 - R
+    for (auto& [copy, next_side] : copies) {
+      node_t::link(successor, copy, side);
+      successor = copy.get();
+      side = next_side;
+    }
+    node_t::link(successor, replace, side);
+  }
 
-      if (get_value(cur_copy.get()) < key) {
-        cur = cur_copy->right_ptr();
+  // top-down split: every node on the search path is copied and hung on
+  // the right spine of the < part or the left spine of the >= part, the
+  // subtrees hanging off the path are shared. subtree counts of the
+  // copies are fixed bottom-up afterwards
+  static std::pair<node_ptr_t, node_ptr_t> split_tree(node_ptr_t const& tree, T const& key) {
+    node_ptr_t less, rest;
+    std::vector<val_node_t*> less_spine, rest_spine;
 
-        successor = cur_copy.get();
-        side = 1;
-      } else if (key < get_value(cur_copy.get())) {
-        cur = cur_copy->left_ptr();
+    for (node_t* cur = tree.get(); cur != nullptr;) {
+      node_ptr_t copy = std::make_shared<val_node_t>(*static_cast<val_node_t*>(cur));
+      if (get_value(cur) < key) {
+        // cur and its left subtree are < key, the right one is split further
+        if (less_spine.empty()) {
+          less = copy;
+        } else {
+          node_t::link_right(less_spine.back(), copy);
+        }
+        less_spine.push_back(copy.get());
+        cur = cur->right_ptr();
+      } else {
+        if (rest_spine.empty()) {
+          rest = copy;
+        } else {
+          node_t::link_left(rest_spine.back(), copy);
+        }
+        rest_spine.push_back(copy.get());
+        cur = cur->left_ptr();
+      }
+    }
 
-        successor = cur_copy.get();
-        side = 0;
+    if (!less_spine.empty()) {
+      node_t::link_right(less_spine.back(), nullptr);
+    }
+    if (!rest_spine.empty()) {
+      node_t::link_left(rest_spine.back(), nullptr);
+    }
+    for (auto* spine : {&less_spine, &rest_spine}) {
+      for (auto it = spine->rbegin(); it != spine->rend(); ++it) {
+        (*it)->update_count();
       }
     }
+    return {std::move(less), std::move(rest)};
   }
 };
 
@@ -189,7 +493,8 @@ struct persistent_set<T>::node_t {
 
   node_t(node_t const& other)
       : left(other.left),
-        right(other.right) {}
+        right(other.right),
+        count(other.count) {}
 
   node_t& operator=(node_t const& other) {
     if (this != &other) {
@@ -200,7 +505,8 @@ struct persistent_set<T>::node_t {
 
   node_t(node_t&& other) 
       : left(std::move(other.left)),
-        right(std::move(other.right)) {}
+        right(std::move(other.right)),
+        count(other.count) {}
 
   node_t& operator=(node_t&& other)  {
     if (this != &other) {
@@ -212,10 +518,12 @@ struct persistent_set<T>::node_t {
 private:
   node_ptr_t left{nullptr};
   node_ptr_t right{nullptr};
+  size_t count{0}; // elements in the subtree, this one included
 
   void copy_from(node_t const& other)  {
     link_left(this, other.left);
     link_right(this, other.right);
+    count = other.count;
   }
 
   void move_from(node_t& other)  {
@@ -232,6 +540,14 @@ private:
     return right.get();
   }
   
+  static size_t count_of(node_ptr_t const& p) {
+    return p ? p->count : 0;
+  }
+
+  void update_count() {
+    count = 1 + count_of(left) + count_of(right);
+  }
+
   static void link_left(node_t* parent, node_ptr_t const& left) {
     if (parent) {
       parent->left = left;
@@ -314,7 +630,9 @@ struct persistent_set<T>::val_node_t : persistent_set<T>::node_t {
   friend persistent_set<T>;
   
   val_node_t() = delete;
-  explicit val_node_t(T const& val) : value(val) {}
+  explicit val_node_t(T const& val) : value(val) {
+    this->count = 1;
+  }
 
   val_node_t(val_node_t const& other) : node_t(other), value(other.value) {}
   
@@ -390,26 +708,173 @@ persistent_set<T>::erase(typename persistent_set<T>::iterator it) {
     return end();
   }
 
+  finger.clear();
   node_t* node = it.ptr;
 
   if (node->is_leaf() || node->has_one_child()) {
-    auto res = ++it;
     node_ptr_t child = node->get_only_child();
     auto key = get_value(node);
 
-    copy_path(key, child, nullptr, nullptr);
+    copy_path(key, child, true);
 
     --size_;
-    return res;
+    // the next node may have been copied above, look it up in this version
+    return upper_bound(key);
   } else {
     auto* n = node_t::next(node, &root);
     auto key = get_value(node);
-    auto l = node->left, r = node->right;
-    node_ptr_t next_copy = std::make_shared<val_node_t>(*static_cast<val_node_t*>(n)); // ok to throw
-    erase(make_iterator(n)); ++size_;
-    copy_path(key, next_copy, l, r);
+    node_ptr_t next_copy = std::make_shared<val_node_t>(get_value(n)); // ok to throw
+    // the successor has no left child, and removing it copies the path
+    // through node, so node's children are taken from the new copy
+    erase(make_iterator(n));
+    node_t* cur = find(key).ptr;
+    node_t::link_left(next_copy.get(), cur->left);
+    node_t::link_right(next_copy.get(), cur->right);
+    next_copy->count = cur->count;
+    copy_path(key, next_copy, false);
 
-    --size_;
     return make_iterator(next_copy.get());
   }
 }
+
+template <typename T>
+template <typename It>
+typename persistent_set<T>::memory_stats
+persistent_set<T>::memory_usage(It first, It last) {
+  struct visit {
+    size_t refs{0};           // all references, from anywhere
+    size_t exclusive_refs{0}; // from the group's sets and exclusive nodes
+  };
+  // a version listed twice still holds one reference to its root
+  std::vector<persistent_set const*> group;
+  for (It it = first; it != last; ++it) {
+    group.push_back(std::addressof(*it));
+  }
+  std::sort(group.begin(), group.end());
+  group.erase(std::unique(group.begin(), group.end()), group.end());
+
+  std::unordered_map<node_t*, visit> seen;
+  std::vector<node_t*> stack;
+
+  // every node once, iteratively: the tree may be deep
+  auto reach = [&](node_ptr_t const& p) {
+    if (p) {
+      visit& v = seen[p.get()];
+      if (v.refs == 0) {
+        v.refs = static_cast<size_t>(p.use_count());
+        stack.push_back(p.get());
+      }
+    }
+  };
+  for (persistent_set const* set : group) {
+    reach(set->root.left);
+  }
+  while (!stack.empty()) {
+    node_t* cur = stack.back();
+    stack.pop_back();
+    reach(cur->left);
+    reach(cur->right);
+  }
+
+  // a node becomes exclusive once all its references are, and only then
+  // passes exclusivity on to its children
+  auto own = [&](node_ptr_t const& p) {
+    if (p) {
+      visit& v = seen[p.get()];
+      if (++v.exclusive_refs == v.refs) {
+        stack.push_back(p.get());
+      }
+    }
+  };
+  memory_stats stats;
+  for (persistent_set const* set : group) {
+    own(set->root.left);
+  }
+  while (!stack.empty()) {
+    node_t* cur = stack.back();
+    stack.pop_back();
+    ++stats.exclusive_nodes;
+    own(cur->left);
+    own(cur->right);
+  }
+
+  stats.nodes = seen.size();
+  stats.shared_nodes = stats.nodes - stats.exclusive_nodes;
+  stats.bytes = stats.nodes * sizeof(val_node_t);
+  stats.exclusive_bytes = stats.exclusive_nodes * sizeof(val_node_t);
+  stats.shared_bytes = stats.shared_nodes * sizeof(val_node_t);
+  return stats;
+}
+
+// blocked Bloom filter: a key sets one bit in each of the 8 words of one
+// 64-byte block. blocks are grouped in chunks, the unit of sharing
+// between versions; a null chunk has no bits set
+template <typename T>
+struct persistent_set<T>::filter_t {
+  static constexpr size_t block_words = 8;
+  static constexpr size_t chunk_blocks = 64;
+  static constexpr size_t bits_per_key = 16;
+
+  struct alignas(64) block_t {
+    std::uint64_t words[block_words]{};
+  };
+  using chunk_t = std::array<block_t, chunk_blocks>;
+
+  explicit filter_t(size_t blocks)
+      : blocks(blocks), chunks((blocks + chunk_blocks - 1) / chunk_blocks) {}
+
+  static size_t blocks_for(size_t keys) {
+    return std::max<size_t>(1, (keys * bits_per_key + block_words * 64 - 1) / (block_words * 64));
+  }
+
+  // std::hash is often the identity, mix it
+  static size_t hash(T const& key) {
+    std::uint64_t h = std::hash<T>{}(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+  }
+
+  // high bits choose the block, low 48 bits the 8 bits in it
+  size_t block_of(size_t h) const {
+    return static_cast<size_t>(((static_cast<std::uint64_t>(h) >> 32) * blocks) >> 32);
+  }
+
+  bool may_contain(size_t h) const {
+    size_t b = block_of(h);
+    chunk_t const* chunk = chunks[b / chunk_blocks].get();
+    if (chunk == nullptr) {
+      return false;
+    }
+    std::uint64_t const* words = (*chunk)[b % chunk_blocks].words;
+    bool all = true;
+    for (size_t i = 0; i < block_words; ++i) {
+      all &= (words[i] >> ((h >> (6 * i)) & 63)) & 1;
+    }
+    return all;
+  }
+
+  // copies the chunk if another version shares it
+  std::uint64_t* writable_block(size_t h) {
+    size_t b = block_of(h);
+    std::shared_ptr<chunk_t>& chunk = chunks[b / chunk_blocks];
+    if (!chunk) {
+      chunk = std::make_shared<chunk_t>();
+    } else if (chunk.use_count() > 1) {
+      chunk = std::make_shared<chunk_t>(*chunk);
+    }
+    return (*chunk)[b % chunk_blocks].words;
+  }
+
+  static void set(std::uint64_t* words, size_t h) noexcept {
+    for (size_t i = 0; i < block_words; ++i) {
+      words[i] |= std::uint64_t(1) << ((h >> (6 * i)) & 63);
+    }
+  }
+
+  size_t blocks;
+  std::vector<std::shared_ptr<chunk_t>> chunks;
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "any_iterator.h"
+
+// lazy filter/transform/take adaptors. each stage wraps the previous
+// iterator type, so a whole pipeline is one concrete iterator that is
+// erased once at the end (see pipeline::erase) instead of paying an
+// any_iterator dispatch and model per stage and element. with
+// any_iterator::read a consumer pays one dispatch per batch
+
+namespace detail {
+// the adaptors are forward iterators over forward sources, input ones
+// otherwise
+template <typename It>
+using adapted_category = std::conditional_t<
+    std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>,
+    std::forward_iterator_tag, std::input_iterator_tag>;
+
+// holds a user callable inside an iterator. a lambda that captures is
+// neither default constructible nor assignable, and an iterator must be
+// both, so the callable lives in an optional that assignment re-emplaces
+template <typename F>
+struct callable_box {
+  callable_box() = default;
+  explicit callable_box(F f) : f(std::in_place, std::move(f)) {}
+
+  callable_box(callable_box const& other) = default;
+  callable_box(callable_box&& other) = default;
+
+  callable_box& operator=(callable_box const& other) {
+    if (this != &other) {
+      assign(other.f);
+    }
+    return *this;
+  }
+  callable_box& operator=(callable_box&& other) noexcept(std::is_nothrow_move_constructible_v<F>) {
+    if (this != &other) {
+      assign(std::move(other.f));
+    }
+    return *this;
+  }
+
+  template <typename... Args>
+  decltype(auto) operator()(Args&&... args) const {
+    return std::invoke(*f, std::forward<Args>(args)...);
+  }
+
+private:
+  // mutable: a callable with a non-const operator() still gets called
+  mutable std::optional<F> f;
+
+  template <typename Opt>
+  void assign(Opt&& other) {
+    f.reset();
+    if (other) {
+      f.emplace(*std::forward<Opt>(other));
+    }
+  }
+};
+} // namespace detail
+
+// elements of [cur, end) for which pred holds
+template <typename It, typename Pred>
+struct filter_iterator {
+  using iterator_category = detail::adapted_category<It>;
+  using value_type = typename std::iterator_traits<It>::value_type;
+  using difference_type = std::ptrdiff_t;
+  using reference = typename std::iterator_traits<It>::reference;
+  using pointer = typename std::iterator_traits<It>::pointer;
+
+  filter_iterator() = default;
+
+  filter_iterator(It cur, It end, Pred pred)
+      : cur(std::move(cur)), end(std::move(end)), pred(std::move(pred)) {
+    skip();
+  }
+
+  reference operator*() const {
+    return *cur;
+  }
+
+  filter_iterator& operator++() {
+    ++cur;
+    skip();
+    return *this;
+  }
+  filter_iterator operator++(int) {
+    filter_iterator tmp(*this);
+    ++*this;
+    return tmp;
+  }
+
+  friend bool operator==(filter_iterator const& a, filter_iterator const& b) {
+    return a.cur == b.cur;
+  }
+  friend bool operator!=(filter_iterator const& a, filter_iterator const& b) {
+    return !(a == b);
+  }
+
+private:
+  // mutable: *cur must give the non-const reference even for sources
+  // like any_iterator whose const operator* doesn't
+  mutable It cur;
+  It end;
+  detail::callable_box<Pred> pred;
+
+  void skip() {
+    while (cur != end && !std::invoke(pred, *cur)) {
+      ++cur;
+    }
+  }
+};
+
+// f(*it) for every element. the result is computed on first access and
+// kept until the iterator moves, so *it is an lvalue and is computed once.
+// that lvalue lives in the iterator: equal iterators give different
+// addresses and it dies with the iterator, so this is an input iterator
+// whatever the source is (and so is every stage after it)
+template <typename It, typename F>
+struct transform_iterator {
+  using iterator_category = std::input_iterator_tag;
+  using value_type = std::remove_cvref_t<std::invoke_result_t<F&, typename std::iterator_traits<It>::reference>>;
+  using difference_type = std::ptrdiff_t;
+  using reference = value_type&;
+  using pointer = value_type*;
+
+  transform_iterator() = default;
+
+  transform_iterator(It cur, F f) : cur(std::move(cur)), f(std::move(f)) {}
+
+  // a copy or an assigned-to iterator computes its own value when first
+  // dereferenced
+  transform_iterator(transform_iterator const& other) : cur(other.cur), f(other.f) {}
+  transform_iterator(transform_iterator&& other) noexcept(
+      std::is_nothrow_move_constructible_v<It> && std::is_nothrow_move_constructible_v<F>)
+      : cur(std::move(other.cur)), f(std::move(other.f)) {}
+
+  transform_iterator& operator=(transform_iterator const& other) {
+    cur = other.cur;
+    f = other.f;
+    cache.reset();
+    return *this;
+  }
+  transform_iterator& operator=(transform_iterator&& other) noexcept(
+      std::is_nothrow_move_assignable_v<It> && std::is_nothrow_move_constructible_v<F>) {
+    cur = std::move(other.cur);
+    f = std::move(other.f);
+    cache.reset();
+    return *this;
+  }
+
+  reference operator*() const {
+    if (!cache) {
+      cache.emplace(std::invoke(f, *cur));
+    }
+    return *cache;
+  }
+  pointer operator->() const {
+    return std::addressof(**this);
+  }
+
+  transform_iterator& operator++() {
+    ++cur;
+    cache.reset();
+    return *this;
+  }
+  transform_iterator operator++(int) {
+    transform_iterator tmp(*this);
+    ++*this;
+    return tmp;
+  }
+
+  friend bool operator==(transform_iterator const& a, transform_iterator const& b) {
+    return a.cur == b.cur;
+  }
+  friend bool operator!=(transform_iterator const& a, transform_iterator const& b) {
+    return !(a == b);
+  }
+
+private:
+  mutable It cur;
+  detail::callable_box<F> f;
+  mutable std::optional<value_type> cache;
+};
+
+// at most n elements of [cur, end)
+template <typename It>
+struct take_iterator {
+  using iterator_category = detail::adapted_category<It>;
+  using value_type = typename std::iterator_traits<It>::value_type;
+  using difference_type = std::ptrdiff_t;
+  using reference = typename std::iterator_traits<It>::reference;
+  using pointer = typename std::iterator_traits<It>::pointer;
+
+  take_iterator() = default;
+
+  take_iterator(It cur, It end, std::size_t left)
+      : cur(std::move(cur)), end(std::move(end)), left(left) {}
+
+  reference operator*() const {
+    return *cur;
+  }
+
+  // the step that uses up the count doesn't move cur: over a filter
+  // that would scan on for a match nobody reads, and an endless or
+  // blocking source would never return
+  take_iterator& operator++() {
+    if (--left != 0) {
+      ++cur;
+    }
+    return *this;
+  }
+  take_iterator operator++(int) {
+    take_iterator tmp(*this);
+    ++*this;
+    return tmp;
+  }
+
+  // all finished iterators are equal, whatever position they stopped at
+  friend bool operator==(take_iterator const& a, take_iterator const& b) {
+    bool a_done = a.done(), b_done = b.done();
+    return a_done || b_done ? a_done == b_done : a.cur == b.cur;
+  }
+  friend bool operator!=(take_iterator const& a, take_iterator const& b) {
+    return !(a == b);
+  }
+
+private:
+  mutable It cur;
+  It end;
+  std::size_t left{0};
+
+  bool done() const {
+    return left == 0 || cur == end;
+  }
+};
+
+// [first, last) with the stages applied so far; each call consumes the
+// pipeline and returns one with a longer iterator type
+template <typename It>
+struct pipeline {
+  pipeline(It first, It last) : first(std::move(first)), last(std::move(last)) {}
+
+  template <typename Pred>
+  pipeline<filter_iterator<It, Pred>> filter(Pred pred) && {
+    return {filter_iterator<It, Pred>(first, last, pred), filter_iterator<It, Pred>(last, last, pred)};
+  }
+
+  template <typename F>
+  pipeline<transform_iterator<It, F>> transform(F f) && {
+    return {transform_iterator<It, F>(std::move(first), f), transform_iterator<It, F>(std::move(last), f)};
+  }
+
+  pipeline<take_iterator<It>> take(std::size_t n) && {
+    return {take_iterator<It>(first, last, n), take_iterator<It>(last, last, 0)};
+  }
+
+  It begin() const {
+    return first;
+  }
+  It end() const {
+    return last;
+  }
+
+  // the single erasure at the API boundary
+  template <typename T, typename Tag = detail::adapted_category<It>>
+  std::pair<any_iterator<T, Tag>, any_iterator<T, Tag>> erase() && {
+    return {any_iterator<T, Tag>(std::move(first)), any_iterator<T, Tag>(std::move(last))};
+  }
+
+private:
+  It first;
+  It last;
+};
+
+template <typename It>
+pipeline<It> make_pipeline(It first, It last) {
+  return pipeline<It>(std::move(first), std::move(last));
+}
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tuple.h"
+
+// radix sort for tuples of arithmetic fields. every record is mapped to a
+// byte key whose lexicographic (memcmp) order is the tuple order: fields
+// are concatenated in index order, each big-endian, with signed integers
+// and floats transformed to sort as unsigned. the keys are then sorted
+// by MSD radix passes, the first split optionally spread over threads.
+// floats are ordered by their bits: -0.0 before 0.0, and NaNs (with the
+// sign bit clear) after +inf
+
+namespace detail {
+template <typename T>
+struct radix_traits;
+
+template <typename T>
+  requires std::unsigned_integral<T> && (!std::same_as<T, bool>)
+struct radix_traits<T> {
+  using bits = T;
+  static constexpr bits encode(T v) noexcept {
+    return v;
+  }
+  static constexpr T decode(bits b) noexcept {
+    return b;
+  }
+};
+
+// flipping the sign bit moves negatives below positives
+template <std::signed_integral T>
+struct radix_traits<T> {
+  using bits = std::make_unsigned_t<T>;
+  static constexpr bits sign = bits(1) << (8 * sizeof(T) - 1);
+  static constexpr bits encode(T v) noexcept {
+    return static_cast<bits>(static_cast<bits>(v) ^ sign);
+  }
+  static constexpr T decode(bits b) noexcept {
+    return static_cast<T>(static_cast<bits>(b ^ sign));
+  }
+};
+
+template <>
+struct radix_traits<bool> {
+  using bits = unsigned char;
+  static constexpr bits encode(bool v) noexcept {
+    return v ? 1 : 0;
+  }
+  static constexpr bool decode(bits b) noexcept {
+    return b != 0;
+  }
+};
+
+// IEEE 754: negatives have every bit flipped (larger magnitude sorts
+// lower), non-negatives just the sign bit
+template <typename T>
+  requires std::is_floating_point_v<T> && std::numeric_limits<T>::is_iec559 &&
+           (sizeof(T) == sizeof(std::uint32_t) || sizeof(T) == sizeof(std::uint64_t))
+struct radix_traits<T> {
+  using bits = std::conditional_t<sizeof(T) == sizeof(std::uint32_t), std::uint32_t, std::uint64_t>;
+  static constexpr bits sign = bits(1) << (8 * sizeof(bits) - 1);
+  static constexpr bits encode(T v) noexcept {
+    bits b = std::bit_cast<bits>(v);
+    return b & sign ? static_cast<bits>(~b) : static_cast<bits>(b | sign);
+  }
+  static constexpr T decode(bits b) noexcept {
+    return std::bit_cast<T>(b & sign ? static_cast<bits>(b ^ sign) : static_cast<bits>(~b));
+  }
+};
+
+template <typename T>
+  requires std::is_enum_v<T>
+struct radix_traits<T> {
+  using underlying = radix_traits<std::underlying_type_t<T>>;
+  using bits = typename underlying::bits;
+  static constexpr bits encode(T v) noexcept {
+    return underlying::encode(static_cast<std::underlying_type_t<T>>(v));
+  }
+  static constexpr T decode(bits b) noexcept {
+    return static_cast<T>(underlying::decode(b));
+  }
+};
+
+template <typename T>
+concept radix_encodable = requires(T v, typename radix_traits<T>::bits b) {
+  { radix_traits<T>::encode(v) } -> std::same_as<typename radix_traits<T>::bits>;
+  { radix_traits<T>::decode(b) } -> std::same_as<T>;
+};
+
+template <typename Tuple, typename Seq = std::make_index_sequence<tuple_size_v<Tuple>>>
+struct radix_layout;
+
+template <typename Tuple, size_t... I>
+struct radix_layout<Tuple, std::index_sequence<I...>> {
+  template <size_t J>
+  using field = radix_traits<std::remove_cvref_t<tuple_element_t<J, Tuple>>>;
+
+  static constexpr bool encodable = (radix_encodable<std::remove_cvref_t<tuple_element_t<I, Tuple>>> && ...);
+  static constexpr size_t size = (sizeof(typename field<I>::bits) + ... + 0);
+  static constexpr std::array<size_t, sizeof...(I)> offsets = [] {
+    std::array<size_t, sizeof...(I)> res{};
+    std::array<size_t, sizeof...(I)> sizes{sizeof(typename field<I>::bits)...};
+    size_t offset = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+      res[i] = offset;
+      offset += sizes[i];
+    }
+    return res;
+  }();
+};
+
+template <typename B>
+constexpr void put_big_endian(unsigned char* out, B bits) noexcept {
+  for (size_t i = 0; i < sizeof(B); ++i) {
+    out[i] = static_cast<unsigned char>(bits >> (8 * (sizeof(B) - 1 - i)));
+  }
+}
+
+template <typename B>
+constexpr B get_big_endian(unsigned char const* in) noexcept {
+  B bits = 0;
+  for (size_t i = 0; i < sizeof(B); ++i) {
+    bits = static_cast<B>(bits << 8 | in[i]);
+  }
+  return bits;
+}
+} // namespace detail
+
+template <typename Tuple>
+concept radix_sortable = detail::radix_layout<Tuple>::encodable;
+
+template <typename Tuple>
+  requires radix_sortable<Tuple>
+inline constexpr size_t radix_key_size_v = detail::radix_layout<Tuple>::size;
+
+template <typename Tuple>
+  requires radix_sortable<Tuple>
+using radix_key_t = std::array<unsigned char, radix_key_size_v<Tuple>>;
+
+// the order-preserving key of t: radix_key(a) < radix_key(b) (as byte
+// strings) iff a < b, up to the float caveats above
+template <typename Tuple>
+  requires radix_sortable<Tuple>
+constexpr radix_key_t<Tuple> radix_key(Tuple const& t) noexcept {
+  using layout = detail::radix_layout<Tuple>;
+  radix_key_t<Tuple> key{};
+  [&]<size_t... I>(std::index_sequence<I...>) {
+    (detail::put_big_endian(key.data() + layout::offsets[I],
+                            layout::template field<I>::encode(get<I>(t))),
+     ...);
+  }(std::make_index_sequence<tuple_size_v<Tuple>>{});
+  return key;
+}
+
+// inverse of radix_key: the encoding is a bijection, so the tuple is
+// rebuilt bit for bit from its key
+template <typename Tuple>
+  requires radix_sortable<Tuple>
+constexpr Tuple from_radix_key(radix_key_t<Tuple> const& key) noexcept {
+  using layout = detail::radix_layout<Tuple>;
+  return [&]<size_t... I>(std::index_sequence<I...>) {
+    return Tuple(layout::template field<I>::decode(
+        detail::get_big_endian<typename layout::template field<I>::bits>(key.data() + layout::offsets[I]))...);
+  }(std::make_index_sequence<tuple_size_v<Tuple>>{});
+}
+
+namespace detail {
+// runs f(lo, hi, t) on [0, n) cut into one chunk per thread
+template <typename F>
+void for_chunks(size_t n, unsigned threads, F const& f) {
+  size_t chunk = (n + threads - 1) / threads;
+  auto job = [&](unsigned t) {
+    f(std::min(n, t * chunk), std::min(n, (t + 1) * chunk), t);
+  };
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (unsigned t = 1; t < threads; ++t) {
+    pool.emplace_back(job, t);
+  }
+  job(0);
+  for (std::thread& th : pool) {
+    th.join();
+  }
+}
+
+// moves src[0, n) to dst by byte `at`, pos[b] being where bucket b
+// starts. a large input has its buckets spread over more pages than the
+// TLB covers, so records are gathered in a small per-bucket buffer and
+// written out a few cache lines at a time
+template <size_t K>
+void scatter(std::array<unsigned char, K> const* src, std::array<unsigned char, K>* dst, size_t n, size_t at,
+             std::array<size_t, 256> pos) {
+  using key = std::array<unsigned char, K>;
+  constexpr size_t buffered = 512 / K > 0 ? 512 / K : 1;
+  if (n < (1 << 14) || buffered == 1) {
+    for (size_t i = 0; i < n; ++i) {
+      dst[pos[src[i][at]]++] = src[i];
+    }
+    return;
+  }
+
+  std::unique_ptr<key[]> buffer = std::make_unique_for_overwrite<key[]>(256 * buffered);
+  std::array<size_t, 256> fill{};
+  for (size_t i = 0; i < n; ++i) {
+    unsigned char b = src[i][at];
+    buffer[b * buffered + fill[b]] = src[i];
+    if (++fill[b] == buffered) {
+      std::copy_n(&buffer[b * buffered], buffered, dst + pos[b]);
+      pos[b] += buffered;
+      fill[b] = 0;
+    }
+  }
+  for (size_t b = 0; b < 256; ++b) {
+    std::copy_n(&buffer[b * buffered], fill[b], dst + pos[b]);
+  }
+}
+
+// keys that reach small_sort mostly differ in their first bytes, where
+// a plain loop beats a call to memcmp
+template <size_t K>
+bool key_less(std::array<unsigned char, K> const& a, std::array<unsigned char, K> const& b, size_t from) noexcept {
+  for (size_t p = from; p < K; ++p) {
+    if (a[p] != b[p]) {
+      return a[p] < b[p];
+    }
+  }
+  return false;
+}
+
+// insertion sort by key bytes [from, K): buckets this small are cheaper
+// to finish by comparison than by another counting pass
+template <size_t K>
+void small_sort(std::array<unsigned char, K>* a, size_t n, size_t from) {
+  for (size_t i = 1; i < n; ++i) {
+    std::array<unsigned char, K> k = a[i];
+    size_t j = i;
+    for (; j > 0 && key_less(k, a[j - 1], from); --j) {
+      a[j] = a[j - 1];
+    }
+    a[j] = k;
+  }
+}
+
+// MSD sort of src[0, n) by key bytes [from, K), ending up in src or, if
+// to_other, in other; the two swap roles on every level instead of
+// copying back. a byte position where every key agrees costs one
+// counting pass and no scatter. random keys leave buckets small after a
+// few bytes, so long keys don't pay a pass per byte as with LSD
+template <size_t K>
+void msd_sort(std::array<unsigned char, K>* src, std::array<unsigned char, K>* other, size_t n, size_t from,
+              bool to_other) {
+  constexpr size_t small = 48;
+  for (; n > small && from < K; ++from) {
+    std::array<size_t, 257> start{};
+    for (size_t i = 0; i < n; ++i) {
+      ++start[src[i][from] + 1];
+    }
+    if (start[src[0][from] + 1] == n) {
+      continue;
+    }
+    for (size_t b = 1; b < 257; ++b) {
+      start[b] += start[b - 1];
+    }
+
+    std::array<size_t, 256> pos;
+    std::copy_n(start.begin(), 256, pos.begin());
+    scatter(src, other, n, from, pos);
+    for (size_t b = 0; b < 256; ++b) {
+      if (start[b + 1] > start[b]) {
+        msd_sort(other + start[b], src + start[b], start[b + 1] - start[b], from + 1, !to_other);
+      }
+    }
+    return;
+  }
+
+  if (to_other) {
+    std::copy_n(src, n, other);
+    src = other;
+  }
+  if (from < K) {
+    small_sort(src, n, from);
+  }
+}
+
+// the first byte position where the keys differ is split across
+// threads, and the buckets are then sorted concurrently. the result
+// ends up in other
+template <size_t K>
+void parallel_sort(std::array<unsigned char, K>* src, std::array<unsigned char, K>* other, size_t n,
+                   unsigned threads) {
+  std::vector<std::array<size_t, 256>> hist(threads);
+  size_t from = 0;
+  for (;; ++from) {
+    if (from == K) {
+      std::copy_n(src, n, other);
+      return;
+    }
+    for_chunks(n, threads, [&](size_t lo, size_t hi, unsigned t) {
+      hist[t].fill(0);
+      for (size_t i = lo; i < hi; ++i) {
+        ++hist[t][src[i][from]];
+      }
+    });
+    size_t same = 0;
+    for (unsigned t = 0; t < threads; ++t) {
+      same += hist[t][src[0][from]];
+    }
+    if (same != n) {
+      break;
+    }
+  }
+
+  // thread t writes bucket b after all smaller buckets and after what
+  // the threads before it put into b
+  std::array<size_t, 257> bucket_start{};
+  size_t sum = 0;
+  for (size_t b = 0; b < 256; ++b) {
+    bucket_start[b] = sum;
+    for (unsigned t = 0; t < threads; ++t) {
+      sum += std::exchange(hist[t][b], sum);
+    }
+  }
+  bucket_start[256] = n;
+
+  for_chunks(n, threads, [&](size_t lo, size_t hi, unsigned t) {
+    scatter(src + lo, other, hi - lo, from, hist[t]);
+  });
+
+  std::atomic<size_t> next{0};
+  for_chunks(threads, threads, [&](size_t, size_t, unsigned) {
+    for (size_t b; (b = next.fetch_add(1, std::memory_order_relaxed)) < 256;) {
+      size_t lo = bucket_start[b];
+      msd_sort(other + lo, src + lo, bucket_start[b + 1] - lo, from + 1, false);
+    }
+  });
+}
+} // namespace detail
+
+// sorts [first, last) of tuples of arithmetic (or enum) fields in the
+// order of their operator<. the elements are replaced by keys, sorted,
+// and decoded back: keys are often smaller than the tuples and nothing
+// is gathered from the input by index. equal keys decode to identical
+// tuples, so stability is moot; -0.0 does come before 0.0. threads > 1
+// splits the work over that many threads once the input is large enough
+// to pay for them
+template <std::random_access_iterator It>
+  requires radix_sortable<std::iter_value_t<It>> && std::indirectly_writable<It, std::iter_value_t<It>>
+void radix_sort(It first, It last, unsigned threads = 1) {
+  using value_type = std::iter_value_t<It>;
+  using key = radix_key_t<value_type>;
+
+  size_t n = static_cast<size_t>(last - first);
+  if (n < 2 || std::tuple_size_v<key> == 0) {
+    return;
+  }
+
+  constexpr size_t min_per_thread = 1 << 16;
+  threads = static_cast<unsigned>(std::clamp<size_t>(n / min_per_thread, 1, std::max(threads, 1u)));
+
+  // written before they are read, no need to zero them
+  std::unique_ptr<key[]> keys = std::make_unique_for_overwrite<key[]>(n);
+  std::unique_ptr<key[]> scratch = std::make_unique_for_overwrite<key[]>(n);
+  detail::for_chunks(n, threads, [&](size_t lo, size_t hi, unsigned) {
+    for (size_t i = lo; i < hi; ++i) {
+      keys[i] = radix_key(first[i]);
+    }
+  });
+
+  key* sorted = keys.get();
+  if (threads > 1) {
+    detail::parallel_sort(keys.get(), scratch.get(), n, threads);
+    sorted = scratch.get();
+  } else {
+    detail::msd_sort(keys.get(), scratch.get(), n, 0, false);
+  }
+
+  detail::for_chunks(n, threads, [&](size_t lo, size_t hi, unsigned) {
+    for (size_t i = lo; i < hi; ++i) {
+      first[i] = from_radix_key<value_type>(sorted[i]);
+    }
+  });
+}
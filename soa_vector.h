@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tuple.h"
+
+// soa_vector -- sequence of tuple<Types...> records stored column-wise:
+// one contiguous array per element type. a scan over one field touches
+// only that field's array (see column<I>), while operator[] and the
+// iterators still give a record view as a tuple of references
+
+template <typename... Types>
+struct soa_vector {
+  static_assert(sizeof...(Types) > 0);
+  static_assert(!(std::is_same_v<Types, bool> || ...),
+                "std::vector<bool> is not contiguous, use char or a wrapper");
+
+  template <bool Const>
+  struct basic_iterator;
+
+  using value_type = tuple<Types...>;
+  using reference = tuple<Types&...>;
+  using const_reference = tuple<Types const&...>;
+  using size_type = size_t;
+  using difference_type = std::ptrdiff_t;
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  template <size_t I>
+  using column_type = tuple_element_t<I, value_type>;
+
+  soa_vector() = default;
+  soa_vector(soa_vector const& other) = default;
+  soa_vector(soa_vector&& other) = default;
+
+  soa_vector& operator=(soa_vector other) {
+    swap(other);
+    return *this;
+  }
+
+  ~soa_vector() = default;
+
+  size_t size() const noexcept {
+    return get<0>(columns).size();
+  }
+
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  // every column can take this many records without reallocation
+  size_t capacity() const noexcept {
+    return for_columns([](auto const&... col) { return std::min({col.capacity()...}); });
+  }
+
+  void reserve(size_t n) {
+    for_columns([n](auto&... col) { (col.reserve(n), ...); });
+  }
+
+  void clear() noexcept {
+    for_columns([](auto&... col) { (col.clear(), ...); });
+  }
+
+  void push_back(Types const&... values) {
+    emplace_back(values...);
+  }
+
+  void push_back(value_type const& value) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      emplace_back(get<I>(value)...);
+    }(std::index_sequence_for<Types...>{});
+  }
+
+  // strong guarantee: either every column grows by one or none does.
+  // values may refer into this container (push_back(get<0>(sv[0]), ...)),
+  // so when the columns are about to reallocate, the record is built
+  // first and moved in afterwards
+  template <typename... UTypes>
+    requires (sizeof...(UTypes) == sizeof...(Types))
+  void emplace_back(UTypes&&... values) {
+    if (size() == capacity()) {
+      value_type record(std::forward<UTypes>(values)...);
+      reserve(size() == 0 ? 1 : 2 * size());
+      [&]<size_t... I>(std::index_sequence<I...>) {
+        append(get<I>(std::move(record))...);
+      }(std::index_sequence_for<Types...>{});
+    } else {
+      append(std::forward<UTypes>(values)...);
+    }
+  }
+
+  void pop_back() noexcept {
+    for_columns([](auto&... col) { (col.pop_back(), ...); });
+  }
+
+  reference operator[](size_t i) noexcept {
+    return for_columns([i](auto&... col) { return reference(col[i]...); });
+  }
+
+  const_reference operator[](size_t i) const noexcept {
+    return for_columns([i](auto const&... col) { return const_reference(col[i]...); });
+  }
+
+  // contiguous view of one field of all records
+  template <size_t I>
+  std::span<column_type<I>> column() noexcept {
+    return get<I>(columns);
+  }
+
+  template <size_t I>
+  std::span<column_type<I> const> column() const noexcept {
+    return get<I>(columns);
+  }
+
+  iterator begin() noexcept {
+    return iterator(this, 0);
+  }
+  iterator end() noexcept {
+    return iterator(this, size());
+  }
+
+  const_iterator begin() const noexcept {
+    return const_iterator(this, 0);
+  }
+  const_iterator end() const noexcept {
+    return const_iterator(this, size());
+  }
+
+  void swap(soa_vector& other) noexcept {
+    ::swap(columns, other.columns);
+  }
+
+  friend void swap(soa_vector& a, soa_vector& b) noexcept {
+    a.swap(b);
+  }
+
+private:
+  tuple<std::vector<Types>...> columns;
+
+  // every column has room for one more record
+  template <typename... UTypes>
+  void append(UTypes&&... values) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      size_t pushed = 0;
+      try {
+        ((get<I>(columns).emplace_back(std::forward<UTypes>(values)), ++pushed), ...);
+      } catch (...) {
+        ((I < pushed ? get<I>(columns).pop_back() : void()), ...);
+        throw;
+      }
+    }(std::index_sequence_for<Types...>{});
+  }
+
+  template <typename F>
+  decltype(auto) for_columns(F f) {
+    return [&]<size_t... I>(std::index_sequence<I...>) -> decltype(auto) {
+      return f(get<I>(columns)...);
+    }(std::index_sequence_for<Types...>{});
+  }
+
+  template <typename F>
+  decltype(auto) for_columns(F f) const {
+    return [&]<size_t... I>(std::index_sequence<I...>) -> decltype(auto) {
+      return f(get<I>(columns)...);
+    }(std::index_sequence_for<Types...>{});
+  }
+};
+
+// random access iterator yielding tuple-of-references proxies. tuple.h
+// gives the proxy what the std algorithms need: an implicit conversion to
+// value_type, a common reference with it, swap of proxy rvalues and
+// assignment through a const proxy, so std::sort(sv.begin(), sv.end())
+// permutes the records across all columns
+template <typename... Types>
+template <bool Const>
+struct soa_vector<Types...>::basic_iterator {
+  friend soa_vector<Types...>;
+  using container = std::conditional_t<Const, soa_vector const, soa_vector>;
+
+  using iterator_category = std::random_access_iterator_tag;
+  using difference_type = std::ptrdiff_t;
+  using value_type = tuple<Types...>;
+  using reference = std::conditional_t<Const, const_reference, soa_vector::reference>;
+  using pointer = void;
+
+  basic_iterator() = default;
+  basic_iterator(basic_iterator const& other) = default;
+
+  // iterator -> const_iterator
+  basic_iterator(basic_iterator<false> const& other) requires Const
+      : owner(other.owner), idx(other.idx) {}
+
+  reference operator*() const {
+    return (*owner)[idx];
+  }
+  reference operator[](difference_type d) const {
+    return (*owner)[idx + d];
+  }
+
+  basic_iterator& operator++() & {
+    ++idx;
+    return *this;
+  }
+  basic_iterator operator++(int) & {
+    basic_iterator tmp(*this);
+    ++idx;
+    return tmp;
+  }
+
+  basic_iterator& operator--() & {
+    --idx;
+    return *this;
+  }
+  basic_iterator operator--(int) & {
+    basic_iterator tmp(*this);
+    --idx;
+    return tmp;
+  }
+
+  basic_iterator& operator+=(difference_type d) {
+    idx += d;
+    return *this;
+  }
+  basic_iterator& operator-=(difference_type d) {
+    idx -= d;
+    return *this;
+  }
+
+  friend basic_iterator operator+(basic_iterator it, difference_type d) {
+    return it += d;
+  }
+  friend basic_iterator operator+(difference_type d, basic_iterator it) {
+    return it += d;
+  }
+  friend basic_iterator operator-(basic_iterator it, difference_type d) {
+    return it -= d;
+  }
+  friend difference_type operator-(basic_iterator const& a, basic_iterator const& b) {
+    return static_cast<difference_type>(a.idx) - static_cast<difference_type>(b.idx);
+  }
+
+  friend bool operator==(basic_iterator const& a, basic_iterator const& b) {
+    return a.idx == b.idx;
+  }
+  friend bool operator!=(basic_iterator const& a, basic_iterator const& b) {
+    return a.idx != b.idx;
+  }
+  friend bool operator<(basic_iterator const& a, basic_iterator const& b) {
+    return a.idx < b.idx;
+  }
+  friend bool operator>(basic_iterator const& a, basic_iterator const& b) {
+    return a.idx > b.idx;
+  }
+  friend bool operator<=(basic_iterator const& a, basic_iterator const& b) {
+    return a.idx <= b.idx;
+  }
+  friend bool operator>=(basic_iterator const& a, basic_iterator const& b) {
+    return a.idx >= b.idx;
+  }
+
+private:
+  container* owner{nullptr};
+  size_t idx{0};
+
+  basic_iterator(container* owner, size_t idx)
+      : owner(owner), idx(idx) {}
+
+  friend basic_iterator<!Const>;
+};
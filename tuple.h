@@ -1,18 +1,29 @@
 #pragma once
 
-#include <tiffio.h>
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <type_traits>
+#include <utility>
 
 namespace detail {
 template<size_t N, typename T>
 struct elt_wrapper {
   constexpr elt_wrapper() : val() {}
-  constexpr explicit elt_wrapper(T val) : val(std::move(val)) {}
-  constexpr elt_wrapper(elt_wrapper const& other) : val(other.val) {}
-  constexpr elt_wrapper(elt_wrapper&& other) : val(std::move(other.val)) {}
-
+  // defaulted, so they are trivial (and noexcept) whenever T's are
+  constexpr elt_wrapper(elt_wrapper const& other) = default;
+  constexpr elt_wrapper(elt_wrapper&& other) = default;
+  constexpr elt_wrapper& operator=(elt_wrapper const& other) = default;
+  constexpr elt_wrapper& operator=(elt_wrapper&& other) = default;
+
+  // the element is constructed in place from whatever was passed,
+  // without an intermediate T
   template <typename Y>
-  constexpr explicit elt_wrapper(Y val) : val(std::move(val)) {}
+    requires std::is_constructible_v<T, Y&&>
+  constexpr explicit elt_wrapper(Y&& val) : val(std::forward<Y>(val)) {}
 
   template <typename Y>
   constexpr explicit elt_wrapper(elt_wrapper<N, Y> const& other) : val(other.val) {}
@@ -20,28 +31,101 @@ struct elt_wrapper {
   template <typename Y>
   constexpr explicit elt_wrapper(elt_wrapper<N, Y>&& other) : val(std::move(other.val)) {}
 
-  T val;
+  // empty elements (comparators, allocators, tags) take no space
+  [[no_unique_address]] T val;
 };
 
-template<typename Seq, class... Types>
-struct tuple_base;
+// finds the unique elt_wrapper base holding index N, whatever position
+// it has among the bases
+template <size_t N, typename T>
+constexpr elt_wrapper<N, T>& as_elt(elt_wrapper<N, T>& e) noexcept {
+  return e;
+}
 
-////////////////////////////////////////////////////
-template<std::size_t N, typename T>
-struct tuple_element;
+template <size_t N, typename T>
+constexpr elt_wrapper<N, T> const& as_elt(elt_wrapper<N, T> const& e) noexcept {
+  return e;
+}
 
-template<std::size_t N, typename Seq, typename Head, typename... Tail>
-struct tuple_element<N, tuple_base<Seq, Head, Tail...>>
-: tuple_element<N - 1, tuple_base<Seq, Tail...>> {};
+// all lookups below are done by overload resolution over a flat pack,
+// so instantiation depth doesn't grow with the number of elements
 
-template<typename Seq, typename Head, typename... Tail>
-struct tuple_element<0, tuple_base<Seq, Head, Tail...>> {
-using type = Head;
+// N-th type of a pack: indexer<...> derives from indexed<I, T> for each
+// element and the call deduces T from the only base with index N
+template <size_t I, typename T>
+struct indexed {
+  using type = T;
 };
 
-template<std::size_t N, typename T>
-using tuple_element_t = typename tuple_element<N, T>::type;
-////////////////////////////////
+template <typename Seq, typename... Types>
+struct indexer;
+
+template <size_t... Idx, typename... Types>
+struct indexer<std::index_sequence<Idx...>, Types...> : indexed<Idx, Types>... {};
+
+template <size_t N, typename T>
+indexed<N, T> select(indexed<N, T>);
+
+#if defined(__has_builtin) && __has_builtin(__type_pack_element)
+template <size_t N, typename... Types>
+using nth_type_t = __type_pack_element<N, Types...>;
+#else
+template <size_t N, typename... Types>
+using nth_type_t =
+    typename decltype(select<N>(indexer<std::index_sequence_for<Types...>, Types...>{}))::type;
+#endif
+
+// index of T in a pack where it occurs exactly once
+template <typename T, size_t I>
+constexpr size_t index_of(indexed<I, T>) noexcept {
+  return I;
+}
+
+template <typename T, typename... Types>
+constexpr size_t idx_by_type() noexcept {
+  static_assert((std::is_same_v<T, Types> + ... + 0) == 1, "type must occur exactly once");
+  return index_of<T>(indexer<std::index_sequence_for<Types...>, Types...>{});
+}
+
+// N-th argument: the first N parameters swallow anything
+template <size_t>
+struct any_arg {
+  template <typename T>
+  constexpr any_arg(T&&) noexcept {}
+};
+
+template <typename Skip>
+struct nth_arg_impl;
+
+template <size_t... Skip>
+struct nth_arg_impl<std::index_sequence<Skip...>> {
+  template <typename T, typename... Rest>
+  static constexpr T&& get(any_arg<Skip>..., T&& arg, Rest&&...) noexcept {
+    return std::forward<T>(arg);
+  }
+};
+
+template <size_t K, typename... Args>
+constexpr decltype(auto) nth_arg(Args&&... args) noexcept {
+  return nth_arg_impl<std::make_index_sequence<K>>::get(std::forward<Args>(args)...);
+}
+
+// assignment of such elements can be left to the defaulted operator=,
+// references have to be assigned through
+template <typename... Types>
+inline constexpr bool trivially_copy_assignable =
+    ((!std::is_reference_v<Types> && std::is_trivially_copy_assignable_v<Types>) && ...);
+
+template <typename... Types>
+inline constexpr bool trivially_move_assignable =
+    ((!std::is_reference_v<Types> && std::is_trivially_move_assignable_v<Types>) && ...);
+
+// tag for constructing from arguments given in logical (index) order
+struct logical_order_t {};
+inline constexpr logical_order_t logical_order{};
+
+template<typename Seq, class... Types>
+struct tuple_base;
 
 template<size_t... Idx, class... Types>
 struct tuple_base<std::index_sequence<Idx...>, Types...> : elt_wrapper<Idx, Types>... {
@@ -50,32 +134,41 @@ struct tuple_base<std::index_sequence<Idx...>, Types...> : elt_wrapper<Idx, Type
   template <size_t N = sizeof...(Types), typename std::enable_if_t<(N > 0), int> = 0>
   constexpr explicit tuple_base(Types const&... args) : elt_wrapper<Idx, Types>(args)... {}
 
-  constexpr tuple_base(tuple_base const& other) : elt_wrapper<Idx, Types>(other.get<Idx>())... {}
-  constexpr tuple_base(tuple_base&& other) : elt_wrapper<Idx, Types>(std::move(other.get<Idx>()))... {}
+  constexpr tuple_base(tuple_base const& other) = default;
+  constexpr tuple_base(tuple_base&& other) = default;
+  constexpr tuple_base& operator=(tuple_base const& other) = default;
+  constexpr tuple_base& operator=(tuple_base&& other) = default;
 
   template <typename... UTypes,
       size_t N = sizeof...(UTypes), size_t M = sizeof...(Types), typename std::enable_if_t<(N > 0 && N == M), int> = 0>
+    requires (std::is_constructible_v<Types, UTypes&&> && ...)
   constexpr explicit tuple_base(UTypes&&... args) : elt_wrapper<Idx, Types>(std::forward<UTypes>(args))... {}
 
   template <typename... UTypes>
   using other_base = tuple_base<std::index_sequence<Idx...>, UTypes...>;
 
+  // Idx need not be sorted: element Idx is taken from the Idx-th argument
+  template <typename... Args>
+  constexpr tuple_base(logical_order_t, Args&&... args)
+      : elt_wrapper<Idx, Types>(nth_arg<Idx>(std::forward<Args>(args)...))... {}
+
   template <typename... UTypes>
   constexpr explicit tuple_base(other_base<UTypes...> const& other)
       : elt_wrapper<Idx, Types>(other.template get<Idx>())... {}
 
   template <typename... UTypes>
   constexpr explicit tuple_base(other_base<UTypes...>&& other)
-      : elt_wrapper<Idx, Types>(std::move(other.template get<Idx>()))... {}
+      : elt_wrapper<Idx, Types>(other.template get<Idx>())... {}
 
   template<std::size_t N>
-  constexpr tuple_element_t<N, tuple_base<std::index_sequence<Idx...>, Types...>> const& get() const noexcept {
-    return static_cast<detail::elt_wrapper<N, tuple_element_t<N, tuple_base<std::index_sequence<Idx...>, Types...>>> const &>(*this).val;
+  constexpr decltype(auto) get() const noexcept {
+    return (as_elt<N>(*this).val);
   }
 
   template<std::size_t N>
-  constexpr tuple_element_t<N, tuple_base<std::index_sequence<Idx...>, Types...>> && get() noexcept {
-    return static_cast<detail::elt_wrapper<N, tuple_element_t<N, tuple_base<std::index_sequence<Idx...>, Types...>>> &&>(*this).val;
+  constexpr decltype(auto) get() noexcept {
+    using type = decltype(as_elt<N>(*this).val);
+    return static_cast<type&&>(as_elt<N>(*this).val);
   }
 };
 
@@ -91,22 +184,135 @@ struct tuple : detail::tuple_base<std::index_sequence_for<Types...>, Types...> {
   template <size_t N = sizeof...(Types), typename std::enable_if_t<(N > 0), int> = 0>
   constexpr explicit tuple(const Types&... args) : base(args...) {}
 
-  tuple(const tuple& other) : base(static_cast<base const &>(other)) {}
-  tuple(tuple&& other) : base(std::move(static_cast<base&&>(other))) {}
+  constexpr tuple(const tuple& other) = default;
+  constexpr tuple(tuple&& other) = default;
 
-  // no need for conditional explicitness
   // convert types constructors
 
   template<typename... UTypes,
       size_t N = sizeof...(UTypes), size_t M = sizeof...(Types), typename std::enable_if_t<(N > 0 && N == M), int> = 0>
+    requires (std::is_constructible_v<Types, UTypes&&> && ...)
   constexpr explicit tuple(UTypes&&... args) : base(std::forward<UTypes>(args)...) {}
 
+  // tuple to tuple conversions are implicit when every element converts
+  // implicitly, so a tuple of references (a proxy reference, see
+  // soa_vector) converts to the tuple of values it refers to
+  template<typename... UTypes>
+    requires (sizeof...(UTypes) == sizeof...(Types) && (std::is_constructible_v<Types, UTypes const&> && ...))
+  constexpr explicit(!(std::is_convertible_v<UTypes const&, Types> && ...))
+  tuple(const tuple<UTypes...>& other) : base(static_cast<detail::tuple_base<std::index_sequence_for<UTypes...>, UTypes...> const &>(other)) {}
+  template<typename... UTypes>
+    requires (sizeof...(UTypes) == sizeof...(Types) && (std::is_constructible_v<Types, UTypes&&> && ...))
+  constexpr explicit(!(std::is_convertible_v<UTypes&&, Types> && ...))
+  tuple(tuple<UTypes...>&& other) : base(std::move(static_cast<detail::tuple_base<std::index_sequence_for<UTypes...>, UTypes...>&&>(other))) {}
+
+  // from a non-const lvalue, so that tuple<T&...> can refer into a tuple<T...>
+  template<typename... UTypes>
+    requires (sizeof...(UTypes) == sizeof...(Types) && !std::is_same_v<tuple<UTypes...>, tuple> &&
+              (std::is_constructible_v<Types, UTypes&> && ...))
+  constexpr explicit(!(std::is_convertible_v<UTypes&, Types> && ...))
+  tuple(tuple<UTypes...>& other) : tuple(detail::logical_order, other, std::index_sequence_for<Types...>{}) {}
+
+  // trivial element types keep tuple trivially copyable, so that
+  // containers of tuples copy and relocate them with memcpy
+  constexpr tuple& operator=(const tuple& other)
+    requires detail::trivially_copy_assignable<Types...> = default;
+  constexpr tuple& operator=(tuple&& other)
+    requires detail::trivially_move_assignable<Types...> = default;
+
+  // otherwise assignment is element-wise, so a tuple of references
+  // (see tie) assigns through to the referenced objects
+  constexpr tuple& operator=(const tuple& other)
+      noexcept((std::is_nothrow_copy_assignable_v<Types> && ...))
+    requires (!detail::trivially_copy_assignable<Types...> &&
+              (std::is_assignable_v<Types&, Types const&> && ...)) {
+    assign(other);
+    return *this;
+  }
+  constexpr tuple& operator=(tuple&& other)
+      noexcept((std::is_nothrow_assignable_v<Types&, Types&&> && ...))
+    requires (!detail::trivially_move_assignable<Types...> &&
+              (std::is_assignable_v<Types&, Types&&> && ...)) {
+    assign(std::move(other));
+    return *this;
+  }
+
+  template<typename... UTypes>
+    requires (sizeof...(UTypes) == sizeof...(Types) && (std::is_assignable_v<Types&, UTypes const&> && ...))
+  constexpr tuple& operator=(const tuple<UTypes...>& other) {
+    assign(other);
+    return *this;
+  }
+  template<typename... UTypes>
+    requires (sizeof...(UTypes) == sizeof...(Types) && (std::is_assignable_v<Types&, UTypes&&> && ...))
+  constexpr tuple& operator=(tuple<UTypes...>&& other) {
+    assign(std::move(other));
+    return *this;
+  }
+
+  // a const tuple of references still assigns to what it refers to (as
+  // std::tuple does since C++23): std::indirectly_writable assigns
+  // through a const proxy reference
   template<typename... UTypes>
-  constexpr explicit tuple(const tuple<UTypes...>& other) : base(static_cast<detail::tuple_base<std::index_sequence_for<UTypes...>, UTypes...> const &>(other)) {}
+    requires (sizeof...(UTypes) == sizeof...(Types) && (std::is_reference_v<Types> && ...) &&
+              (std::is_assignable_v<Types const&, UTypes const&> && ...))
+  constexpr tuple const& operator=(const tuple<UTypes...>& other) const {
+    assign_through(other);
+    return *this;
+  }
   template<typename... UTypes>
-  constexpr explicit tuple(tuple<UTypes...>&& other) : base(std::move(static_cast<detail::tuple_base<std::index_sequence_for<UTypes...>, UTypes...>&&>(other))) {}
+    requires (sizeof...(UTypes) == sizeof...(Types) && (std::is_reference_v<Types> && ...) &&
+              (std::is_assignable_v<Types const&, UTypes&&> && ...))
+  constexpr tuple const& operator=(tuple<UTypes...>&& other) const {
+    assign_through(std::move(other));
+    return *this;
+  }
+
+private:
+  template<typename Other, size_t... I>
+  constexpr tuple(detail::logical_order_t, Other& other, std::index_sequence<I...>)
+      : base(detail::logical_order, get<I>(other)...) {}
+
+  template<typename Other>
+  constexpr void assign(Other&& other) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      ((get<I>(*this) = get<I>(std::forward<Other>(other))), ...);
+    }(std::index_sequence_for<Types...>{});
+  }
+
+  template<typename Other>
+  constexpr void assign_through(Other&& other) const {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      ((get<I>(*this) = get<I>(std::forward<Other>(other))), ...);
+    }(std::index_sequence_for<Types...>{});
+  }
 };
 
+namespace detail {
+struct empty_probe {};
+struct other_empty_probe {};
+struct final_empty_probe final {};
+struct move_only_probe {
+  move_only_probe(move_only_probe&&) = default;
+  move_only_probe& operator=(move_only_probe&&) = default;
+};
+
+static_assert(sizeof(tuple<empty_probe, int>) == sizeof(int));
+static_assert(sizeof(tuple<int, empty_probe>) == sizeof(int));
+static_assert(sizeof(tuple<empty_probe, other_empty_probe, int>) == sizeof(int));
+static_assert(sizeof(tuple<empty_probe, empty_probe, int>) == sizeof(int));
+static_assert(sizeof(tuple<final_empty_probe, int>) == sizeof(int));
+
+static_assert(std::is_trivially_copyable_v<tuple<int, double, empty_probe>>);
+static_assert(std::is_trivially_copy_constructible_v<tuple<int, double>>);
+static_assert(std::is_trivially_move_assignable_v<tuple<int, double>>);
+static_assert(std::is_trivially_destructible_v<tuple<int, double>>);
+static_assert(std::is_nothrow_move_constructible_v<tuple<int, int*>>);
+static_assert(std::is_nothrow_move_assignable_v<tuple<int, int*>>);
+static_assert(std::is_copy_assignable_v<tuple<int&, double>>);
+static_assert(!std::is_trivially_copy_assignable_v<tuple<int&, double>>);
+} // namespace detail
+
 // make_tuple -- constructor with auto deducing types
 // note references are dereferenced
 // see cppreference
@@ -124,25 +330,44 @@ struct unwrap_refwrapper<std::reference_wrapper<T>> {
 template <typename T>
 using unwrap_decay_t = typename unwrap_refwrapper<std::decay_t<T>>::type;
 
+namespace detail {
+// always satisfied. an argument of a std type makes ADL find
+// std::make_tuple/forward_as_tuple/tie next to ours, with the same
+// parameters; of two such templates the constrained one is more
+// specialized, so the calls below pick ours instead of being ambiguous
+template <typename... Types>
+concept any_arguments = true;
+} // namespace detail
+
 template<typename... Types>
+  requires detail::any_arguments<Types...>
 constexpr tuple<unwrap_decay_t<Types>...> make_tuple(Types&&... args) {
   return tuple<unwrap_decay_t<Types>...>(std::forward<Types>(args)...);
 }
 
+// forward_as_tuple -- tuple of references to the arguments, keeping
+// their value category
+template<typename... Types>
+  requires detail::any_arguments<Types...>
+constexpr tuple<Types&&...> forward_as_tuple(Types&&... args) noexcept {
+  return tuple<Types&&...>(std::forward<Types>(args)...);
+}
+
+// tie -- tuple of lvalue references, assigning to it assigns to args
+template<typename... Types>
+  requires detail::any_arguments<Types...>
+constexpr tuple<Types&...> tie(Types&... args) noexcept {
+  return tuple<Types&...>(args...);
+}
+
 // NOTE: if not tuple passed to helpers -- must be compiler error
 // tuple_element -- return type by it's number (type field)
 template<std::size_t N, typename T>
 struct tuple_element;
 
-template<std::size_t N, typename Head, typename... Tail>
-struct tuple_element<N, tuple<Head, Tail...>>
-    : tuple_element<N - 1, tuple<Tail...>> {};
-//  using type = typename tuple_element<N - 1, tuple<Tail...>>::type;
-//};
-
-template<typename Head, typename... Tail>
-struct tuple_element<0, tuple<Head, Tail...>> {
-  using type = Head;
+template<std::size_t N, typename... Types>
+struct tuple_element<N, tuple<Types...>> {
+  using type = detail::nth_type_t<N, Types...>;
 };
 
 template<std::size_t N, typename T>
@@ -158,6 +383,28 @@ struct tuple_size<tuple<Types...>> : std::integral_constant<size_t, sizeof...(Ty
 template<typename T>
 inline constexpr size_t tuple_size_v = tuple_size<T>::value;
 
+// std tuple protocol -- structured bindings and std code written against
+// std::tuple_size/std::tuple_element see tuple directly (get is found by ADL)
+template<typename... Types>
+struct std::tuple_size<::tuple<Types...>> : std::integral_constant<size_t, sizeof...(Types)> {};
+
+template<std::size_t N, typename... Types>
+struct std::tuple_element<N, ::tuple<Types...>> {
+  using type = ::tuple_element_t<N, ::tuple<Types...>>;
+};
+
+// the common reference of two tuples is the tuple of the elements'
+// common references, as for std::tuple since C++23. with it a tuple of
+// references and the tuple of values it refers to satisfy
+// std::common_reference_with, which iterators with proxy references
+// (soa_vector's) need to model std::indirectly_readable
+template<typename... TTypes, typename... UTypes, template<typename> class TQual, template<typename> class UQual>
+  requires (sizeof...(TTypes) == sizeof...(UTypes)) &&
+           requires { typename ::tuple<std::common_reference_t<TQual<TTypes>, UQual<UTypes>>...>; }
+struct std::basic_common_reference<::tuple<TTypes...>, ::tuple<UTypes...>, TQual, UQual> {
+  using type = ::tuple<std::common_reference_t<TQual<TTypes>, UQual<UTypes>>...>;
+};
+
 // get -- main function to interact with tuple
 // NOTE: think how to replace int in return type
 // NOTE: compiler error if N > tuple_size
@@ -184,32 +431,15 @@ template<std::size_t N, typename... Types>
 constexpr const tuple_element_t<N, tuple<Types...>>&& get(const tuple<Types...>&& t) noexcept {
   static_assert(N < sizeof...(Types));
   using type = tuple_element_t<N, tuple<Types...>>;
-  return std::forward<type>(static_cast<detail::elt_wrapper<N, type> const &&>(t).val);
+  return std::forward<type const>(static_cast<detail::elt_wrapper<N, type> const &&>(t).val);
 }
 
 
-template <typename T, typename... Types>
-constexpr size_t idx_by_type() {
-  constexpr size_t size = sizeof...(Types);
-  size_t idx = size;
-  constexpr bool same[size] = { std::is_same_v<T, Types>... };
-
-  for (size_t i = 0; i < sizeof...(Types); ++i) {
-    if (same[i]) {
-      if (idx != size) {
-        return size;
-      }
-      idx = i;
-    }
-  }
-  return idx;
-}
-
 // gets by type
 // NOTE: compiler error if many T in one tuple
 template<typename T, typename... Types>
 constexpr T& get(tuple<Types...>& t) noexcept {
-  constexpr size_t idx = idx_by_type<T, Types...>();
+  constexpr size_t idx = detail::idx_by_type<T, Types...>();
   static_assert(idx < sizeof...(Types));
 
   return static_cast<detail::elt_wrapper<idx, T>&>(t).val;
@@ -217,7 +447,7 @@ constexpr T& get(tuple<Types...>& t) noexcept {
 
 template<typename T, typename... Types>
 constexpr T&& get(tuple<Types...>&& t) noexcept {
-  constexpr size_t idx = idx_by_type<T, Types...>();
+  constexpr size_t idx = detail::idx_by_type<T, Types...>();
   static_assert(idx < sizeof...(Types));
 
   return std::forward<T>(static_cast<detail::elt_wrapper<idx, T>&&>(t).val);
@@ -225,83 +455,477 @@ constexpr T&& get(tuple<Types...>&& t) noexcept {
 
 template<typename T, typename... Types>
 constexpr const T& get(const tuple<Types...>& t) noexcept {
-  constexpr size_t idx = idx_by_type<T, Types...>();
+  constexpr size_t idx = detail::idx_by_type<T, Types...>();
   static_assert(idx < sizeof...(Types));
 
-  return static_cast<detail::elt_wrapper<idx, T>&>(t).val;
+  return static_cast<detail::elt_wrapper<idx, T> const&>(t).val;
 }
 
 template<typename T, typename... Types>
 constexpr const T&& get(const tuple<Types...>&& t) noexcept {
-  constexpr size_t idx = idx_by_type<T, Types...>();
+  constexpr size_t idx = detail::idx_by_type<T, Types...>();
   static_assert(idx < sizeof...(Types));
 
-  return std::forward<T>(static_cast<detail::elt_wrapper<idx, T>&&>(t).val);
+  return std::forward<T const>(static_cast<detail::elt_wrapper<idx, T> const&&>(t).val);
 }
 
 // swap specialization
-template <size_t I, typename... TTypes, typename... UTypes>
-constexpr void swap(tuple<TTypes...>& first, tuple<UTypes...>& second) {
-  using std::swap;
-  swap(get<I>(first), get<I>(second));
-  if constexpr (I + 1 < sizeof...(TTypes))
-    swap<I + 1>(first, second);
+// (one pack, so it stays more specialized than std::swap found by ADL)
+template<typename... Types>
+constexpr void swap(tuple<Types...>& first, tuple<Types...>& second) {
+  [&]<size_t... I>(std::index_sequence<I...>) {
+    using std::swap;
+    (swap(get<I>(first), get<I>(second)), ...);
+  }(std::index_sequence_for<Types...>{});
 }
 
-template<typename... TTypes, typename... UTypes>
-void swap(tuple<TTypes...>& first, tuple<UTypes...>& second) {
-  static_assert(sizeof...(TTypes) == sizeof...(UTypes));
-  swap<0>(first, second);
+// tuples of references returned by value (proxy references) swap the
+// objects they refer to, which is what swap(*a, *b) means for them
+template<typename... Types>
+constexpr void swap(tuple<Types&...>&& first, tuple<Types&...>&& second) {
+  [&]<size_t... I>(std::index_sequence<I...>) {
+    using std::swap;
+    (swap(get<I>(first), get<I>(second)), ...);
+  }(std::index_sequence_for<Types...>{});
+}
+
+// apply -- calls f with the elements of t, each forwarded with the
+// value category of t. overloads instead of a single Tuple&& template,
+// so that ours is more specialized than std::apply found by ADL
+
+namespace detail {
+template<typename F, typename Tuple, size_t... I>
+constexpr decltype(auto) apply(F&& f, Tuple&& t, std::index_sequence<I...>) {
+  return std::invoke(std::forward<F>(f), get<I>(std::forward<Tuple>(t))...);
+}
+} // namespace detail
+
+template<typename F, typename... Types>
+constexpr decltype(auto) apply(F&& f, tuple<Types...>& t) {
+  return detail::apply(std::forward<F>(f), t, std::index_sequence_for<Types...>{});
+}
+
+template<typename F, typename... Types>
+constexpr decltype(auto) apply(F&& f, const tuple<Types...>& t) {
+  return detail::apply(std::forward<F>(f), t, std::index_sequence_for<Types...>{});
+}
+
+template<typename F, typename... Types>
+constexpr decltype(auto) apply(F&& f, tuple<Types...>&& t) {
+  return detail::apply(std::forward<F>(f), std::move(t), std::index_sequence_for<Types...>{});
+}
+
+template<typename F, typename... Types>
+constexpr decltype(auto) apply(F&& f, const tuple<Types...>&& t) {
+  return detail::apply(std::forward<F>(f), std::move(t), std::index_sequence_for<Types...>{});
+}
+
+// tuple_cat -- one tuple with the elements of all arguments. the result
+// is built by a single constructor call: for every result element K the
+// pair (argument outer[K], element inner[K]) is computed at compile time
+// and the element is forwarded straight from its source
+
+namespace detail {
+template<typename T>
+struct is_tuple : std::false_type {};
+
+template<typename... Types>
+struct is_tuple<tuple<Types...>> : std::true_type {};
+
+template<typename... Tuples>
+struct cat_plan {
+  static constexpr size_t total = (tuple_size_v<Tuples> + ... + 0);
+
+  struct indices {
+    std::array<size_t, total> outer{};
+    std::array<size_t, total> inner{};
+  };
+
+  static constexpr indices make() {
+    indices res;
+    std::array<size_t, sizeof...(Tuples)> sizes{tuple_size_v<Tuples>...};
+    size_t k = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+      for (size_t j = 0; j < sizes[i]; ++j, ++k) {
+        res.outer[k] = i;
+        res.inner[k] = j;
+      }
+    }
+    return res;
+  }
+
+  static constexpr indices plan = make();
+
+  template<size_t K>
+  using element = tuple_element_t<plan.inner[K], nth_type_t<plan.outer[K], Tuples...>>;
+
+  template<typename Seq>
+  struct result;
+
+  template<size_t... K>
+  struct result<std::index_sequence<K...>> {
+    using type = tuple<element<K>...>;
+  };
+
+  using result_t = typename result<std::make_index_sequence<total>>::type;
+};
+
+template<typename Plan, typename Refs, size_t... K>
+constexpr typename Plan::result_t tuple_cat(Refs&& refs, std::index_sequence<K...>) {
+  return typename Plan::result_t(
+      get<Plan::plan.inner[K]>(get<Plan::plan.outer[K]>(std::move(refs)))...);
+}
+} // namespace detail
+
+template<typename... Tuples>
+  requires (detail::is_tuple<std::remove_cvref_t<Tuples>>::value && ...)
+constexpr auto tuple_cat(Tuples&&... tuples) {
+  using plan = detail::cat_plan<std::remove_cvref_t<Tuples>...>;
+  return detail::tuple_cat<plan>(::forward_as_tuple(std::forward<Tuples>(tuples)...),
+                                 std::make_index_sequence<plan::total>{});
 }
 
 // compare operators
+// ordering is a single pass of <=> over the elements, == a single pass of ==
+// (<, >, <=, >= and != are rewritten from these)
 
-template<size_t I, typename... TTypes, typename... UTypes>
-constexpr bool less(const tuple<TTypes...>& first, const tuple<UTypes...>& second) {
-  if constexpr (I >= sizeof...(TTypes) - 1) {
-    return false;
+namespace detail {
+// a <=> b, or one made of < for types that only have <
+struct synth_three_way_fn {
+  template <typename T, typename U>
+  constexpr auto operator()(const T& a, const U& b) const
+    requires requires {
+      { a < b } -> std::convertible_to<bool>;
+      { b < a } -> std::convertible_to<bool>;
+    }
+  {
+    if constexpr (std::three_way_comparable_with<T, U>) {
+      return a <=> b;
+    } else {
+      if (a < b) {
+        return std::weak_ordering::less;
+      }
+      if (b < a) {
+        return std::weak_ordering::greater;
+      }
+      return std::weak_ordering::equivalent;
+    }
   }
+};
+
+inline constexpr synth_three_way_fn synth_three_way{};
 
-  return (get<I>(first) < get<I>(second))
-         || ((get<I>(second) == get<I>(first)) && less<I + 1>(first, second));
+template <typename T, typename U>
+using synth_three_way_result = decltype(synth_three_way(std::declval<T const&>(), std::declval<U const&>()));
+
+// unsigned bytes order as memcmp orders them
+template <typename T>
+inline constexpr bool memcmp_ordered =
+    std::is_same_v<T, unsigned char> || std::is_same_v<T, char8_t>;
+
+// == on these is a compare of the object bytes; a class type may define
+// == any way it likes (and a reference compares what it refers to)
+template <typename T>
+inline constexpr bool bytewise_equal =
+    std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>;
+
+// how many leading elements are such bytes on both sides
+template <bool... Bytes>
+constexpr size_t byte_prefix() {
+  std::array<bool, sizeof...(Bytes)> bytes{Bytes...};
+  size_t n = 0;
+  while (n < bytes.size() && bytes[n]) {
+    ++n;
+  }
+  return n;
 }
 
-template <size_t I, typename... TTypes, typename... UTypes>
-constexpr bool eq(const tuple<TTypes...>& first, const tuple<UTypes...>& second) {
-  if constexpr (I >= sizeof...(TTypes)) {
-    return true;
+template<typename... TTypes, typename... UTypes, size_t... I>
+constexpr auto compare(const tuple<TTypes...>& first, const tuple<UTypes...>& second, std::index_sequence<I...>) {
+  using result_t = std::common_comparison_category_t<synth_three_way_result<TTypes, UTypes>...>;
+  constexpr size_t prefix = byte_prefix<(memcmp_ordered<TTypes> && memcmp_ordered<UTypes>)...>();
+
+  // a run of byte fields is compared at once, provided the bases are
+  // laid out in index order (they are on all common ABIs)
+  if constexpr (prefix > 1) {
+    if (!std::is_constant_evaluated()) {
+      auto* a = reinterpret_cast<unsigned char const*>(&get<0>(first));
+      auto* b = reinterpret_cast<unsigned char const*>(&get<0>(second));
+      if (reinterpret_cast<unsigned char const*>(&get<prefix - 1>(first)) == a + prefix - 1 &&
+          reinterpret_cast<unsigned char const*>(&get<prefix - 1>(second)) == b + prefix - 1) {
+        int r = std::memcmp(a, b, prefix);
+        if (r != 0) {
+          return result_t(r < 0 ? std::strong_ordering::less : std::strong_ordering::greater);
+        }
+        result_t result = std::strong_ordering::equal;
+        (void)((I >= prefix && (result = synth_three_way(get<I>(first), get<I>(second))) != 0) || ...);
+        return result;
+      }
+    }
   }
 
-  return (get<I>(first) == get<I>(second))
-         && eq<I + 1>(first, second);
+  // first element that differs decides, each pair is compared once
+  result_t result = std::strong_ordering::equal;
+  (void)(((result = synth_three_way(get<I>(first), get<I>(second))) != 0) || ...);
+  return result;
 }
 
+template <typename... TTypes, typename... UTypes, size_t... I>
+constexpr bool eq(const tuple<TTypes...>& first, const tuple<UTypes...>& second, std::index_sequence<I...>) {
+  // no padding and no two representations of a value: equal iff same bytes
+  if constexpr ((std::is_same_v<TTypes, UTypes> && ...) && (bytewise_equal<TTypes> && ...) &&
+                std::has_unique_object_representations_v<tuple<TTypes...>>) {
+    if (!std::is_constant_evaluated()) {
+      return std::memcmp(&first, &second, sizeof(first)) == 0;
+    }
+  }
+  return (static_cast<bool>(get<I>(first) == get<I>(second)) && ...);
+}
+} // namespace detail
+
 template<typename... TTypes, typename... UTypes>
 constexpr bool operator==(const tuple<TTypes...>& first, const tuple<UTypes...>& second) {
   static_assert(sizeof...(TTypes) == sizeof...(UTypes));
 
-  return eq<0>(first, second);
-}
-template<typename... TTypes, typename... UTypes>
-constexpr bool operator!=(const tuple<TTypes...>& first, const tuple<UTypes...>& second) {
-  return !(first == second);
+  return detail::eq(first, second, std::index_sequence_for<TTypes...>{});
 }
 
 template<typename... TTypes, typename... UTypes>
-constexpr bool operator<(const tuple<TTypes...>& first, const tuple<UTypes...>& second) {
+constexpr std::common_comparison_category_t<detail::synth_three_way_result<TTypes, UTypes>...>
+operator<=>(const tuple<TTypes...>& first, const tuple<UTypes...>& second) {
   static_assert(sizeof...(TTypes) == sizeof...(UTypes));
 
-  return less<0>(first, second);
+  return detail::compare(first, second, std::index_sequence_for<TTypes...>{});
 }
-template<typename... TTypes, typename... UTypes>
-constexpr bool operator>(const tuple<TTypes...>& first, const tuple<UTypes...>& second) {
-  return second < first;
+
+// packed_tuple -- same elements and indices as tuple, but stored in
+// order of decreasing alignment, so there is no padding between elements
+// (for power-of-two alignments) and the object is as small as it can be.
+// get<I> still uses the logical index I: the element wrappers keep their
+// logical index, only the order of the bases is changed
+
+namespace detail {
+template <typename... Types>
+constexpr std::array<size_t, sizeof...(Types)> layout_order() {
+  constexpr size_t size = sizeof...(Types);
+  std::array<size_t, size> order{};
+  std::array<size_t, size> align{alignof(elt_wrapper<0, Types>)...};
+
+  // stable insertion sort, equal alignments keep their declaration order
+  for (size_t i = 0; i < size; ++i) {
+    size_t j = i;
+    for (; j > 0 && align[order[j - 1]] < align[i]; --j) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+  return order;
 }
-template<typename... TTypes, typename... UTypes>
-constexpr bool operator<=(const tuple<TTypes...>& first, const tuple<UTypes...>& second) {
-  return !(second < first);
+
+template <typename Seq, typename... Types>
+struct packed_base;
+
+template <size_t... Pos, typename... Types>
+struct packed_base<std::index_sequence<Pos...>, Types...> {
+  static constexpr std::array<size_t, sizeof...(Types)> order = layout_order<Types...>();
+
+  using type = tuple_base<std::index_sequence<order[Pos]...>,
+                          ::tuple_element_t<order[Pos], tuple<Types...>>...>;
+};
+
+template <typename... Types>
+using packed_base_t = typename packed_base<std::index_sequence_for<Types...>, Types...>::type;
+} // namespace detail
+
+template<typename... Types>
+struct packed_tuple : detail::packed_base_t<Types...> {
+  using base = detail::packed_base_t<Types...>;
+
+  constexpr packed_tuple() = default;
+
+  template <size_t N = sizeof...(Types), typename std::enable_if_t<(N > 0), int> = 0>
+  constexpr explicit packed_tuple(const Types&... args) : base(detail::logical_order, args...) {}
+
+  template<typename... UTypes,
+      size_t N = sizeof...(UTypes), size_t M = sizeof...(Types), typename std::enable_if_t<(N > 0 && N == M), int> = 0>
+  constexpr explicit packed_tuple(UTypes&&... args) : base(detail::logical_order, std::forward<UTypes>(args)...) {}
+
+  constexpr packed_tuple(const packed_tuple& other) = default;
+  constexpr packed_tuple(packed_tuple&& other) = default;
+
+  constexpr packed_tuple& operator=(const packed_tuple& other) = default;
+  constexpr packed_tuple& operator=(packed_tuple&& other) = default;
+};
+
+template<typename... Types>
+constexpr packed_tuple<unwrap_decay_t<Types>...> make_packed_tuple(Types&&... args) {
+  return packed_tuple<unwrap_decay_t<Types>...>(std::forward<Types>(args)...);
 }
-template<typename... TTypes, typename... UTypes>
-constexpr bool operator>=(const tuple<TTypes...>& first, const tuple<UTypes...>& second) {
-  return !(first < second);
+
+template<std::size_t N, typename... Types>
+struct tuple_element<N, packed_tuple<Types...>> : tuple_element<N, tuple<Types...>> {};
+
+template<typename... Types>
+struct tuple_size<packed_tuple<Types...>> : std::integral_constant<size_t, sizeof...(Types)> {};
+
+template<typename... Types>
+struct std::tuple_size<::packed_tuple<Types...>> : std::integral_constant<size_t, sizeof...(Types)> {};
+
+template<std::size_t N, typename... Types>
+struct std::tuple_element<N, ::packed_tuple<Types...>> {
+  using type = ::tuple_element_t<N, ::tuple<Types...>>;
+};
+
+template<std::size_t N, typename... Types>
+constexpr tuple_element_t<N, tuple<Types...>>& get(packed_tuple<Types...>& t) noexcept {
+  static_assert(N < sizeof...(Types));
+  return static_cast<detail::elt_wrapper<N, tuple_element_t<N, tuple<Types...>>>&>(t).val;
+}
+
+template<std::size_t N, typename... Types>
+constexpr tuple_element_t<N, tuple<Types...>>&& get(packed_tuple<Types...>&& t) noexcept {
+  static_assert(N < sizeof...(Types));
+  using type = tuple_element_t<N, tuple<Types...>>;
+  return std::forward<type>(static_cast<detail::elt_wrapper<N, type>&&>(t).val);
+}
+
+template<std::size_t N, typename... Types>
+constexpr const tuple_element_t<N, tuple<Types...>>& get(const packed_tuple<Types...>& t) noexcept {
+  static_assert(N < sizeof...(Types));
+  return static_cast<detail::elt_wrapper<N, tuple_element_t<N, tuple<Types...>>> const &>(t).val;
+}
+
+template<std::size_t N, typename... Types>
+constexpr const tuple_element_t<N, tuple<Types...>>&& get(const packed_tuple<Types...>&& t) noexcept {
+  static_assert(N < sizeof...(Types));
+  using type = tuple_element_t<N, tuple<Types...>>;
+  return std::forward<type const>(static_cast<detail::elt_wrapper<N, type> const &&>(t).val);
+}
+
+namespace detail {
+static_assert(std::is_trivially_copyable_v<packed_tuple<char, double, empty_probe>>);
+static_assert(std::is_trivially_copy_assignable_v<packed_tuple<char, double>>);
+static_assert(std::is_trivially_move_assignable_v<packed_tuple<char, double>>);
+static_assert(std::is_nothrow_move_assignable_v<packed_tuple<int, int*>>);
+static_assert(!std::is_copy_assignable_v<packed_tuple<int, move_only_probe>>);
+static_assert(std::is_move_assignable_v<packed_tuple<int, move_only_probe>>);
+} // namespace detail
+
+// hashing -- std::hash<tuple> combines the element hashes; a tuple whose
+// bytes are its value (no padding, no floats) is hashed in one pass over
+// its object representation instead
+
+namespace detail {
+inline constexpr std::uint64_t hash_mul = 0x9ddfea08eb382d69ULL;
+
+// murmur3 finalizer: every input bit affects every output bit
+constexpr std::uint64_t hash_fmix(std::uint64_t h) noexcept {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+constexpr std::uint64_t hash_step(std::uint64_t h, std::uint64_t word) noexcept {
+  h = (h ^ word) * hash_mul;
+  return h ^ (h >> 47);
+}
+
+// 8 bytes at a time, the tail zero-padded
+inline std::uint64_t hash_bytes(unsigned char const* p, size_t n) noexcept {
+  std::uint64_t h = hash_fmix(n + 0x9e3779b97f4a7c15ULL);
+  for (; n >= sizeof(std::uint64_t); p += sizeof(std::uint64_t), n -= sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    h = hash_step(h, word);
+  }
+  if (n != 0) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, p, n);
+    h = hash_step(h, word);
+  }
+  return static_cast<size_t>(hash_fmix(h));
+}
+
+template <typename T>
+concept std_hashable = requires(T const& v) {
+  { std::hash<T>{}(v) } -> std::convertible_to<size_t>;
+};
+} // namespace detail
+
+template<typename... Types>
+  requires (detail::std_hashable<std::remove_cvref_t<Types>> && ...)
+struct std::hash<::tuple<Types...>> {
+  size_t operator()(::tuple<Types...> const& t) const {
+    // same condition as the memcmp in ==, equal tuples must hash equal
+    if constexpr ((::detail::bytewise_equal<Types> && ...) &&
+                  std::has_unique_object_representations_v<::tuple<Types...>>) {
+      return ::detail::hash_bytes(reinterpret_cast<unsigned char const*>(&t), sizeof(t));
+    } else {
+      return [&]<size_t... I>(std::index_sequence<I...>) {
+        std::uint64_t h = sizeof...(Types);
+        ((h = ::detail::hash_step(h, std::hash<std::remove_cvref_t<Types>>{}(get<I>(t)))), ...);
+        return static_cast<size_t>(::detail::hash_fmix(h));
+      }(std::index_sequence_for<Types...>{});
+    }
+  }
+};
+
+// packed binary encoding -- the fields of a tuple of trivially copyable
+// types back to back in index order, native byte order, no padding and
+// empty fields omitted. offsets are computed at compile time, so encode
+// and decode are a fixed sequence of fixed-size copies
+
+namespace detail {
+template <typename T>
+inline constexpr size_t wire_size = std::is_empty_v<T> ? 0 : sizeof(T);
+
+template <typename... Types>
+constexpr std::array<size_t, sizeof...(Types)> wire_offsets() {
+  std::array<size_t, sizeof...(Types)> sizes{wire_size<Types>...};
+  std::array<size_t, sizeof...(Types)> offsets{};
+  size_t offset = 0;
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    offsets[i] = offset;
+    offset += sizes[i];
+  }
+  return offsets;
+}
+
+template <typename... Types>
+concept wire_encodable = ((std::is_trivially_copyable_v<Types> && !std::is_reference_v<Types>) && ...);
+} // namespace detail
+
+template<typename T>
+struct encoded_size;
+
+template<typename... Types>
+  requires detail::wire_encodable<Types...>
+struct encoded_size<tuple<Types...>> : std::integral_constant<size_t, (detail::wire_size<Types> + ... + 0)> {};
+
+template<typename T>
+inline constexpr size_t encoded_size_v = encoded_size<T>::value;
+
+// writes encoded_size_v<tuple<Types...>> bytes to out, returns the end
+template<typename... Types>
+  requires detail::wire_encodable<Types...>
+std::byte* encode_tuple(tuple<Types...> const& t, std::byte* out) noexcept {
+  constexpr auto offsets = detail::wire_offsets<Types...>();
+  [&]<size_t... I>(std::index_sequence<I...>) {
+    (std::memcpy(out + offsets[I], __builtin_addressof(get<I>(t)), detail::wire_size<Types>), ...);
+  }(std::index_sequence_for<Types...>{});
+  return out + encoded_size_v<tuple<Types...>>;
+}
+
+// reads what encode_tuple wrote into t, returns the end of the record
+template<typename... Types>
+  requires detail::wire_encodable<Types...>
+std::byte const* decode_tuple(std::byte const* in, tuple<Types...>& t) noexcept {
+  constexpr auto offsets = detail::wire_offsets<Types...>();
+  [&]<size_t... I>(std::index_sequence<I...>) {
+    (std::memcpy(__builtin_addressof(get<I>(t)), in + offsets[I], detail::wire_size<Types>), ...);
+  }(std::index_sequence_for<Types...>{});
+  return in + encoded_size_v<tuple<Types...>>;
 }
@@ -0,0 +1,98 @@
+// per-TU cost of including tuple.h, standalone (run from this directory):
+//   g++ -std=c++20 -O2 tuple_compile_bench.cpp -o tuple_compile_bench
+// preprocesses and compiles a TU that includes only tuple.h with $CXX
+// (default g++), reports preprocessed lines and best-of compile time, then
+// what each standard header tuple.h includes costs on its own. given a
+// line budget, exits non-zero when the TU preprocesses to more than that
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int ROUNDS = 5;
+
+std::string compiler() {
+  char const* cxx = std::getenv("CXX");
+  return cxx != nullptr ? cxx : "g++";
+}
+
+// lines the compiler emits preprocessing source, or -1 if it failed
+long preprocessed_lines(std::string const& source) {
+  std::string command = "echo '" + source + "' | " + compiler() + " -std=c++20 -E -P -x c++ -I. - 2>/dev/null";
+  FILE* pipe = popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    return -1;
+  }
+  long lines = 0;
+  char buf[4096];
+  while (std::fgets(buf, sizeof buf, pipe) != nullptr) {
+    ++lines;
+  }
+  return pclose(pipe) == 0 ? lines : -1;
+}
+
+// best of ROUNDS for a full front-end pass over source, in ms
+double compile_ms(std::string const& source) {
+  std::string command = "echo '" + source + "' | " + compiler() + " -std=c++20 -fsyntax-only -x c++ -I. - 2>/dev/null";
+  double best = 1e300;
+  for (int r = 0; r < ROUNDS; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    if (std::system(command.c_str()) != 0) {
+      return -1;
+    }
+    std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+    best = std::min(best, took.count());
+  }
+  return best;
+}
+
+// the <...> includes of the header, in order
+std::vector<std::string> std_includes(char const* header) {
+  std::vector<std::string> found;
+  std::ifstream in(header);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind("#include <", 0) == 0) {
+      found.push_back(line.substr(9, line.find('>') - 8));
+    }
+  }
+  return found;
+}
+
+void row(char const* what, long lines, double ms) {
+  std::printf("%-22s %10ld %10.1f\n", what, lines, ms);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string tu = "#include \"tuple.h\"";
+  long lines = preprocessed_lines(tu);
+  if (lines < 0) {
+    std::fprintf(stderr, "%s can't preprocess tuple.h from here\n", compiler().c_str());
+    return 2;
+  }
+
+  std::printf("%s, best of %d\n", compiler().c_str(), ROUNDS);
+  std::printf("%-22s %10s %10s\n", "TU", "lines", "ms");
+  row("empty", preprocessed_lines(""), compile_ms(""));
+  row("tuple.h", lines, compile_ms(tu));
+  for (std::string const& header : std_includes("tuple.h")) {
+    std::string alone = "#include " + header;
+    row(header.c_str(), preprocessed_lines(alone), compile_ms(alone));
+  }
+
+  if (argc > 1) {
+    long budget = std::atol(argv[1]);
+    if (lines > budget) {
+      std::printf("\ntuple.h preprocesses to %ld lines, over the budget of %ld\n", lines, budget);
+      return 1;
+    }
+  }
+}